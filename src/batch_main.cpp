@@ -0,0 +1,361 @@
+// ----------------- batch_main.cpp -----------------
+// Headless runner: applies a saved graph to every file in a directory or
+// glob. Decode, evaluation and encode are separate pipeline stages joined
+// by bounded queues, so file N+1 decodes while N evaluates and N-1 encodes.
+// When the output is a video file or a %d sequence, the input is read as
+// one ordered stream (video, sequence, glob or directory) instead. With
+// --sweep, one image is evaluated over a grid of parameter values and the
+// output is a contact sheet of the results.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <thread>
+#include "bounded_queue.h"
+#include "frame_stream.h"
+#include "graph_io.h"
+#include "image_export.h"
+#include "param_sweep.h"
+#include "process_pool.h"
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    std::string graph, input, output, ext;
+    int workers = 0;
+    int ioThreads = 2;
+    int queueDepth = 4;
+    int processes = 0;
+    int timeoutMs = 120000;
+    std::vector<std::string> sweeps;
+    double scale = 1.0;
+    int sheetWidth = 256;
+    ExportOptions encode;
+};
+
+struct Job {
+    std::string path;
+    Frame image;
+};
+
+struct Stats {
+    std::atomic<int> done{0}, failed{0};
+    std::atomic<long long> pixels{0};
+    std::atomic<long long> decodeUs{0}, evalUs{0}, encodeUs{0};
+};
+
+long long since(Clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t).count();
+}
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: node_batch --graph <file> --input <dir|glob> --output <dir>\n"
+        "                  [--workers N] [--io-threads N] [--queue N] [--ext .png]\n"
+        "                  [--png-level 0-9] [--jpeg-quality 0-100] [--tile N]\n"
+        "                  [--processes N] [--timeout ms]\n"
+        "       node_batch --graph <file> --input <video|seq_%%04d.png|glob|dir>\n"
+        "                  --output <video|out_%%04d.png> [--queue N]\n"
+        "       node_batch --graph <file> --input <image> --output <sheet.png>\n"
+        "                  --sweep Type.param=from:to:count [--sweep ...]\n"
+        "                  [--workers N] [--scale S] [--sheet-width N]\n"
+        "  --workers     concurrent graph evaluations (default: all cores)\n"
+        "  --io-threads  decode threads and encode threads, each (default: 2)\n"
+        "  --queue       frames buffered between stages (default: 4)\n"
+        "  --ext         output extension (default: same as input); .ntf writes\n"
+        "                the memory-mapped tiled format\n"
+        "  --tile        tile size of .ntf and tiled TIFF output (default: 256)\n"
+        "  --processes   evaluate in N worker processes, frames passed through\n"
+        "                shared memory; a crash or overrun fails only that file\n"
+        "  --timeout     per-file limit with --processes (default: 120000)\n"
+        "  --sweep       vary a parameter of the first node of that type; each\n"
+        "                further --sweep multiplies the grid\n"
+        "  --scale       render scale of a sweep (default: 1)\n"
+        "  --sheet-width contact sheet cell width (default: 256)\n");
+}
+
+bool parse(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        auto next = [&]() -> std::string { return i+1 < argc ? argv[++i] : ""; };
+        if      (a == "--graph")      o.graph = next();
+        else if (a == "--input")      o.input = next();
+        else if (a == "--output")     o.output = next();
+        else if (a == "--ext")        o.ext = next();
+        else if (a == "--workers")    o.workers = std::atoi(next().c_str());
+        else if (a == "--io-threads") o.ioThreads = std::max(1, std::atoi(next().c_str()));
+        else if (a == "--queue")      o.queueDepth = std::max(1, std::atoi(next().c_str()));
+        else if (a == "--png-level")  o.encode.pngCompression = std::atoi(next().c_str());
+        else if (a == "--jpeg-quality") o.encode.jpegQuality = std::atoi(next().c_str());
+        else if (a == "--tile")       o.encode.tileSize = std::atoi(next().c_str());
+        else if (a == "--processes")  o.processes = std::max(0, std::atoi(next().c_str()));
+        else if (a == "--timeout")    o.timeoutMs = std::max(1, std::atoi(next().c_str()));
+        else if (a == "--sweep")      o.sweeps.push_back(next());
+        else if (a == "--scale")      o.scale = std::atof(next().c_str());
+        else if (a == "--sheet-width") o.sheetWidth = std::max(16, std::atoi(next().c_str()));
+        else return false;
+    }
+    return !o.graph.empty() && !o.input.empty() && !o.output.empty();
+}
+
+std::vector<std::string> listInputs(const std::string& input) {
+    std::vector<std::string> files;
+    if (fs::is_directory(input)) {
+        for (auto& e : fs::directory_iterator(input))
+            if (e.is_regular_file()) files.push_back(e.path().string());
+        std::sort(files.begin(), files.end());
+    } else {
+        cv::glob(input, files, false);
+    }
+    return files;
+}
+
+bool isStreamOutput(const std::string& output) {
+    return output.find('%') != std::string::npos
+        || (!fs::is_directory(output) && fs::path(output).has_extension());
+}
+
+// Frames stay in order, so there is one graph: decode of N+1 and encode of
+// N-1 overlap its evaluation of N on the reader and writer threads.
+int runStream(const Options& opt) {
+    NodeGraph g;
+    loadGraph(g, opt.graph, true);
+    g.resultCache().setBudget(0);
+    auto in = findNode<InputNode>(g);
+    auto out = findNode<OutputNode>(g);
+    if (!in || !out) throw std::runtime_error("Graph needs an Input and an Output node");
+
+    fs::path parent = fs::path(opt.output).parent_path();
+    if (!parent.empty()) fs::create_directories(parent);
+    FrameReader reader(opt.input, opt.queueDepth);
+    FrameWriter writer(opt.output, reader.fps(), opt.queueDepth);
+
+    auto start = Clock::now();
+    long long evalUs = 0, pixels = 0;
+    int frames = 0;
+    Frame f;
+    while (reader.next(f)) {
+        auto t0 = Clock::now();
+        in->setImage(f);
+        g.evaluate();
+        evalUs += since(t0);
+        pixels += f.size().area();
+        writer.write(out->getResult());
+        frames++;
+    }
+    f = Frame();
+    writer.close();
+
+    double secs = since(start) / 1e6;
+    std::printf("Processed %d frames in %.2f s: %.1f fps (source %.1f fps), %.1f MP/s\n",
+                frames, secs, frames / secs, reader.fps(), pixels / 1e6 / secs);
+    std::printf("Mean evaluate %.1f ms per frame, peak pooled frames %.1f MB\n",
+                evalUs / 1e3 / std::max(1, frames), FramePool::instance().stats().peak / 1048576.0);
+    if (reader.skipped()) std::fprintf(stderr, "Skipped %d files that failed to decode\n", reader.skipped());
+    return 0;
+}
+
+// "Type.param=from:to:count", applied to the first node of that type.
+SweepAxis parseAxis(const NodeGraph& g, const std::string& spec) {
+    size_t dot = spec.find('.'), eq = spec.find('=');
+    if (dot == std::string::npos || eq == std::string::npos || eq < dot)
+        throw std::runtime_error("Bad --sweep " + spec);
+    std::string type = spec.substr(0, dot);
+    Node* node = nullptr;
+    for (auto& kv : g.nodes)
+        if (kv.second->typeName() == type && (!node || kv.first < node->id)) node = kv.second.get();
+    if (!node) throw std::runtime_error("Graph has no " + type + " node");
+    double from = 0, to = 0;
+    int count = 0;
+    if (std::sscanf(spec.c_str() + eq + 1, "%lf:%lf:%d", &from, &to, &count) != 3 || count < 1)
+        throw std::runtime_error("Bad --sweep " + spec);
+    SweepAxis a;
+    a.node = node->id;
+    a.param = spec.substr(dot + 1, eq - dot - 1);
+    a.values = SweepAxis::range(from, to, count);
+    return a;
+}
+
+int runSweep(const Options& opt) {
+    NodeGraph g;
+    loadGraph(g, opt.graph, true);
+    auto in = findNode<InputNode>(g);
+    if (!in || !findNode<OutputNode>(g)) throw std::runtime_error("Graph needs an Input and an Output node");
+    in->setImage(InputNode::decode(opt.input), opt.input);
+    g.setRenderScale(opt.scale);
+    std::vector<SweepAxis> axes;
+    for (auto& spec : opt.sweeps) axes.push_back(parseAxis(g, spec));
+
+    SweepOptions so;
+    so.parallel = opt.workers;
+    so.cellWidth = opt.sheetWidth;
+    // Every lane runs its own copy of the graph at once.
+    int hw = int(std::max(1u, std::thread::hardware_concurrency()));
+    NodeGraph::setThreadBudget(std::max(1, hw / (so.parallel > 0 ? so.parallel : std::max(1, hw / 2))));
+    auto start = Clock::now();
+    SweepResult r = sweepParameters(g, axes, so);
+    double secs = since(start) / 1e6;
+    exportImage(opt.output, r.sheet, opt.encode);
+    std::printf("Swept %zu combinations in %.2f s: %.1f ms each\n",
+                r.frames.size(), secs, secs * 1e3 / std::max<size_t>(1, r.frames.size()));
+    std::printf("Peak pooled frames %.1f MB\n", FramePool::instance().stats().peak / 1048576.0);
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    // Started by a ProcessPool: serve jobs on the inherited socket.
+    if (argc >= 3 && std::string(argv[1]) == "--worker") {
+        int threads = 0;
+        size_t cacheBytes = 0;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string a = argv[i];
+            if (a == "--threads") threads = std::atoi(argv[i + 1]);
+            else if (a == "--cache") cacheBytes = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        return runPoolWorker(std::atoi(argv[2]), threads, cacheBytes);
+    }
+
+    Options opt;
+    if (!parse(argc, argv, opt)) { usage(); return 2; }
+    if (!opt.sweeps.empty()) {
+        try { return runSweep(opt); }
+        catch (const std::exception& e) { std::fprintf(stderr, "%s\n", e.what()); return 1; }
+    }
+    int hw = int(std::max(1u, std::thread::hardware_concurrency()));
+    // Two evaluations per process, so one is being packed while the other runs.
+    if (opt.workers <= 0) opt.workers = opt.processes ? 2 * opt.processes : hw;
+
+    if (isStreamOutput(opt.output)) {
+        try { return runStream(opt); }
+        catch (const std::exception& e) { std::fprintf(stderr, "%s\n", e.what()); return 1; }
+    }
+
+    std::vector<std::string> files = listInputs(opt.input);
+    if (files.empty()) { std::fprintf(stderr, "No input files match %s\n", opt.input.c_str()); return 1; }
+    fs::create_directories(opt.output);
+
+    // One graph instance per worker; validate the file once up front.
+    std::vector<std::unique_ptr<NodeGraph>> graphs;
+    std::shared_ptr<ProcessPool> pool;
+    NodeGraph::setThreadBudget(std::max(1, hw / opt.workers));
+    try {
+        if (opt.processes) {
+            ProcessPoolOptions po;
+            po.workers = opt.processes;
+            po.timeoutMs = opt.timeoutMs;
+            po.residentBytes = 0;   // each file is used once
+            po.cacheBytes = 0;
+            pool = std::make_shared<ProcessPool>(po);
+        }
+        for (int w = 0; w < opt.workers; w++) {
+            auto g = std::make_unique<NodeGraph>();
+            loadGraph(*g, opt.graph, true);
+            g->resultCache().setBudget(0);   // every file is new; nothing to reuse
+            g->setProcessPool(pool);
+            if (!findNode<InputNode>(*g) || !findNode<OutputNode>(*g))
+                throw std::runtime_error("Graph needs an Input and an Output node");
+            graphs.push_back(std::move(g));
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    BoundedQueue<Job> decoded(opt.queueDepth), evaluated(opt.queueDepth);
+    std::atomic<size_t> nextFile{0};
+    std::atomic<int> decodersLeft{opt.ioThreads}, workersLeft{opt.workers};
+    Stats stats;
+    auto start = Clock::now();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < opt.ioThreads; t++) threads.emplace_back([&]{
+        for (size_t i; (i = nextFile++) < files.size(); ) {
+            auto t0 = Clock::now();
+            Frame img;
+            try {
+                if (auto tiled = openTiledImage(files[i])) {
+                    // Read whole: the graph runs on, and the output is
+                    // encoded from, the full frame.
+                    cv::Mat m;
+                    tiled->read(cv::Rect(cv::Point(0,0), tiled->size()), m);
+                    img = Frame(m, tiled->order());
+                } else {
+                    img = Frame(cv::imread(files[i]), ChannelOrder::BGR);
+                }
+            } catch (const std::exception&) {}
+            if (img.empty()) {
+                std::fprintf(stderr, "Failed to decode %s\n", files[i].c_str());
+                stats.failed++;
+                continue;
+            }
+            stats.decodeUs += since(t0);
+            decoded.push({files[i], img});
+        }
+        if (--decodersLeft == 0) decoded.close();
+    });
+    for (int w = 0; w < opt.workers; w++) threads.emplace_back([&, w]{
+        NodeGraph& g = *graphs[w];
+        auto in = findNode<InputNode>(g);
+        auto out = findNode<OutputNode>(g);
+        Job job;
+        while (decoded.pop(job)) {
+            auto t0 = Clock::now();
+            try {
+                in->setImage(job.image);
+                g.evaluate();
+                stats.pixels += job.image.size().area();
+                job.image = out->getResult();
+                stats.evalUs += since(t0);
+                evaluated.push(std::move(job));
+            } catch (const std::exception& e) {
+                std::fprintf(stderr, "Failed to process %s: %s\n", job.path.c_str(), e.what());
+                stats.failed++;
+                // Nothing the failed pass left half done may stand in for
+                // the next file's result.
+                for (auto& kv : g.nodes) kv.second->markDirty();
+            }
+        }
+        if (--workersLeft == 0) evaluated.close();
+    });
+    for (int t = 0; t < opt.ioThreads; t++) threads.emplace_back([&]{
+        Job job;
+        while (evaluated.pop(job)) {
+            auto t0 = Clock::now();
+            fs::path src(job.path);
+            fs::path dst = fs::path(opt.output) / src.stem();
+            dst += opt.ext.empty() ? src.extension().string() : opt.ext;
+            try {
+                exportImage(dst.string(), job.image, opt.encode);
+                stats.encodeUs += since(t0);
+                stats.done++;
+            } catch (const std::exception& e) {
+                std::fprintf(stderr, "Failed to write %s: %s\n", dst.string().c_str(), e.what());
+                stats.failed++;
+            }
+        }
+    });
+    for (auto& t : threads) t.join();
+
+    double secs = since(start) / 1e6;
+    int n = std::max(1, stats.done.load());
+    std::printf("Processed %d/%zu files in %.2f s (%d failed)\n",
+                stats.done.load(), files.size(), secs, stats.failed.load());
+    std::printf("Throughput: %.2f files/s, %.1f MP/s\n",
+                stats.done / secs, stats.pixels / 1e6 / secs);
+    std::printf("Mean per file: decode %.1f ms, evaluate %.1f ms, encode %.1f ms\n",
+                stats.decodeUs / 1e3 / n, stats.evalUs / 1e3 / n, stats.encodeUs / 1e3 / n);
+    std::printf("Peak pooled frames: %.1f MB\n", FramePool::instance().stats().peak / 1048576.0);
+    if (pool) {
+        auto ps = pool->stats();
+        std::printf("Worker processes: %d, %llu jobs, %llu failed, %llu timed out, %llu restarts\n",
+                    pool->workers(), (unsigned long long)ps.jobs, (unsigned long long)ps.failed,
+                    (unsigned long long)ps.timeouts, (unsigned long long)ps.restarts);
+    }
+    return stats.failed ? 1 : 0;
+}
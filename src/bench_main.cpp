@@ -0,0 +1,769 @@
+// ----------------- bench_main.cpp -----------------
+// Headless benchmark suite. Eight groups:
+//   node   - per-node throughput (MP/s) over image size, channels, blur radius and mode
+//   kernel - each blur algorithm against the dense reference: speed and max error,
+//            checked against a per-algorithm tolerance
+//   graph  - end-to-end latency and peak pooled frame memory for linear, fan-out
+//            and deep topologies: cold, warm and streaming
+//   simd   - each row kernel per instruction set, checked against scalar, with speedup
+//   scale  - graph bookkeeping on synthetic 10k-node graphs: wiring, invalidation, scheduling
+//   open   - time to first pixel for a JPEG, full decode against reduced decode
+//   sweep  - a 4x4 blur radius x contrast grid, serial re-evaluation against one sweep
+//   recover - good frames through a graph right after a frame that made a node throw
+// Results go to stdout or --out as JSON or CSV, one record per measurement.
+// A record with a tolerance fails the run, exit code 1, if its max_abs_diff
+// exceeds it.
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "node_framework.h"
+#include "param_sweep.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    std::vector<double> sizes{1, 10, 100};     // megapixels
+    std::vector<int> channels{1, 3, 4};
+    std::vector<int> radii{1, 5, 20, 50};
+    std::vector<std::string> suites{"node", "kernel", "graph", "simd", "scale", "open", "sweep", "recover"};
+    std::string format = "json", out;
+    int reps = 5;
+    int nodes = 10000;                         // scale suite graph size
+};
+
+struct Record {
+    std::string suite, name, algorithm, mode;
+    int width = 0, height = 0, channels = 0, radius = 0, nodes = 0, reps = 0;
+    double medianMs = 0, minMs = 0, maxAbsDiff = -1, speedup = -1, peakMB = -1;
+    double tolerance = -1;   // largest acceptable maxAbsDiff; negative: not checked
+};
+
+struct Timing { double median, min; };
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: node_bench [--sizes 1,10,100] [--channels 1,3,4] [--radii 1,5,20,50]\n"
+        "                  [--suite node,kernel,graph,simd,scale,open,sweep,recover] [--nodes N] [--reps N]\n"
+        "                  [--format json|csv] [--out file]\n"
+        "  --sizes     image sizes in megapixels (4:3 aspect)\n"
+        "  --nodes     node count for the scale suite (default: 10000)\n"
+        "  --reps      timed repetitions per case after one warm-up (default: 5)\n"
+        "  --out       write results here instead of stdout\n"
+        "Exits 1 if any result differs from its reference by more than its tolerance.\n");
+}
+
+template <typename T>
+std::vector<T> parseList(const std::string& s) {
+    std::vector<T> v;
+    std::stringstream ss(s);
+    for (std::string item; std::getline(ss, item, ','); )
+        if (!item.empty()) v.push_back(T(std::atof(item.c_str())));
+    return v;
+}
+
+std::vector<std::string> parseNames(const std::string& s) {
+    std::vector<std::string> v;
+    std::stringstream ss(s);
+    for (std::string item; std::getline(ss, item, ','); )
+        if (!item.empty()) v.push_back(item);
+    return v;
+}
+
+bool parse(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        auto next = [&]() -> std::string { return i+1 < argc ? argv[++i] : ""; };
+        if      (a == "--sizes")    o.sizes = parseList<double>(next());
+        else if (a == "--channels") o.channels = parseList<int>(next());
+        else if (a == "--radii")    o.radii = parseList<int>(next());
+        else if (a == "--suite")    o.suites = parseNames(next());
+        else if (a == "--reps")     o.reps = std::max(1, std::atoi(next().c_str()));
+        else if (a == "--nodes")    o.nodes = std::max(2, std::atoi(next().c_str()));
+        else if (a == "--format")   o.format = next();
+        else if (a == "--out")      o.out = next();
+        else return false;
+    }
+    return (o.format == "json" || o.format == "csv") && !o.sizes.empty();
+}
+
+bool wants(const Options& o, const std::string& suite) {
+    return std::find(o.suites.begin(), o.suites.end(), suite) != o.suites.end();
+}
+
+// Runs fn once untimed, then reps times.
+template <typename F>
+Timing measure(int reps, F&& fn) {
+    fn();
+    std::vector<double> ms;
+    for (int i = 0; i < reps; i++) {
+        auto t0 = Clock::now();
+        fn();
+        ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+    }
+    std::sort(ms.begin(), ms.end());
+    return {ms[ms.size() / 2], ms.front()};
+}
+
+// As above, with setup() run untimed before every call.
+template <typename S, typename F>
+Timing measure(int reps, S&& setup, F&& fn) {
+    std::vector<double> ms;
+    for (int i = 0; i <= reps; i++) {
+        setup();
+        auto t0 = Clock::now();
+        fn();
+        if (i > 0) ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+    }
+    std::sort(ms.begin(), ms.end());
+    return {ms[ms.size() / 2], ms.front()};
+}
+
+cv::Mat noise(double mp, int channels) {
+    int w = int(std::round(std::sqrt(mp * 1e6 * 4.0 / 3.0)));
+    int h = int(std::round(mp * 1e6 / w));
+    cv::Mat m(h, w, CV_MAKETYPE(CV_8U, channels));
+    cv::randu(m, cv::Scalar::all(0), cv::Scalar::all(256));
+    return m;
+}
+
+const char* modeName(BlurNode::Mode m) { return m == BlurNode::DIRECTIONAL ? "directional" : "uniform"; }
+
+const char* algorithmName(blur::Algorithm a) {
+    switch (a) {
+    case blur::Algorithm::Reference:         return "reference";
+    case blur::Algorithm::SeparableGaussian: return "separable_gaussian";
+    case blur::Algorithm::BoxCascade:        return "box_cascade";
+    case blur::Algorithm::LineIntegral:      return "line_integral";
+    }
+    return "";
+}
+
+// === Node throughput ===
+// Times process() alone on an already-evaluated Input -> node graph.
+void benchNode(const Options& opt, const cv::Mat& img, std::shared_ptr<Node> node,
+               Record rec, std::vector<Record>& out) {
+    NodeGraph g;
+    auto in = std::make_shared<InputNode>();
+    in->setImage(img);
+    g.addNode(in);
+    g.addNode(node);
+    g.connectNodes(in->id, node->id);
+    g.resultCache().setBudget(0);
+    g.evaluate();
+
+    Timing t = measure(opt.reps, [&]{ node->markDirty(); node->process(); });
+    rec.suite = "node";
+    rec.name = node->typeName();
+    rec.width = img.cols;
+    rec.height = img.rows;
+    rec.channels = img.channels();
+    rec.reps = opt.reps;
+    rec.medianMs = t.median;
+    rec.minMs = t.min;
+    out.push_back(rec);
+}
+
+void nodeSuite(const Options& opt, std::vector<Record>& out) {
+    for (double mp : opt.sizes)
+        for (int cn : opt.channels) {
+            cv::Mat img = noise(mp, cn);
+            auto bc = std::make_shared<BrightnessContrastNode>();
+            bc->setBrightness(20);
+            bc->setContrast(1.3f);
+            benchNode(opt, img, bc, {}, out);
+
+            for (auto mode : {BlurNode::UNIFORM, BlurNode::DIRECTIONAL})
+                for (int r : opt.radii) {
+                    auto b = std::make_shared<BlurNode>();
+                    b->setRadius(r);
+                    b->setMode(mode);
+                    b->setAngle(30.0f);
+                    Record rec;
+                    rec.mode = modeName(mode);
+                    rec.radius = r;
+                    rec.algorithm = algorithmName(blur::choose(mode == BlurNode::DIRECTIONAL, r));
+                    benchNode(opt, img, b, rec, out);
+                }
+        }
+}
+
+// === Blur kernels vs reference ===
+// Largest max_abs_diff against the dense reference accepted on noise. The
+// exact kernels differ only by rounding. The box cascade approximates the
+// Gaussian and is held to a bound only above kBoxCascadeRadius, where
+// BlurNode uses it; narrower, it is measured but not checked.
+double blurTolerance(blur::Algorithm algo, int radius) {
+    switch (algo) {
+    case blur::Algorithm::Reference:         return 0;
+    case blur::Algorithm::SeparableGaussian: return 1;
+    case blur::Algorithm::LineIntegral:      return 1;
+    case blur::Algorithm::BoxCascade:        return radius > blur::kBoxCascadeRadius ? 3 : -1;
+    }
+    return -1;
+}
+
+// Error is measured on the smallest size only; the dense reference is too
+// slow to run at 100 MP for every radius.
+void kernelSuite(const Options& opt, std::vector<Record>& out) {
+    double smallest = *std::min_element(opt.sizes.begin(), opt.sizes.end());
+    for (double mp : opt.sizes)
+        for (int cn : opt.channels) {
+            cv::Mat img = noise(mp, cn);
+            for (bool directional : {false, true})
+                for (int r : opt.radii) {
+                    std::vector<blur::Algorithm> algos;
+                    if (directional) algos = {blur::Algorithm::LineIntegral};
+                    else algos = {blur::Algorithm::SeparableGaussian, blur::Algorithm::BoxCascade};
+
+                    cv::Mat ref;
+                    if (mp == smallest) {
+                        blur::apply(img, ref, blur::Algorithm::Reference, directional, r, 30.0f, 1.0f);
+                        algos.push_back(blur::Algorithm::Reference);
+                    }
+                    for (auto algo : algos) {
+                        cv::Mat res;
+                        Timing t = measure(opt.reps, [&]{
+                            blur::apply(img, res, algo, directional, r, 30.0f, 1.0f);
+                        });
+                        Record rec;
+                        rec.suite = "kernel";
+                        rec.name = "Blur";
+                        rec.algorithm = algorithmName(algo);
+                        rec.mode = directional ? "directional" : "uniform";
+                        rec.width = img.cols;
+                        rec.height = img.rows;
+                        rec.channels = cn;
+                        rec.radius = r;
+                        rec.reps = opt.reps;
+                        rec.medianMs = t.median;
+                        rec.minMs = t.min;
+                        if (!ref.empty()) {
+                            rec.maxAbsDiff = cv::norm(res, ref, cv::NORM_INF);
+                            rec.tolerance = blurTolerance(algo, r);
+                        }
+                        out.push_back(rec);
+                    }
+                }
+        }
+}
+
+// === Graph latency ===
+std::shared_ptr<Node> addBlur(NodeGraph& g, int radius) {
+    auto b = std::make_shared<BlurNode>();
+    b->setRadius(radius);
+    g.addNode(b);
+    return b;
+}
+
+std::shared_ptr<Node> addBC(NodeGraph& g, int brightness) {
+    auto bc = std::make_shared<BrightnessContrastNode>();
+    bc->setBrightness(brightness);
+    bc->setContrast(1.1f);
+    g.addNode(bc);
+    return bc;
+}
+
+// Chain of `length` nodes alternating blur and brightness/contrast so
+// pointwise fusion doesn't collapse it.
+std::shared_ptr<Node> chain(NodeGraph& g, std::shared_ptr<Node> from, int length) {
+    for (int i = 0; i < length; i++) {
+        auto n = i % 2 == 0 ? addBlur(g, 3) : addBC(g, 5);
+        g.connectNodes(from->id, n->id);
+        from = n;
+    }
+    return from;
+}
+
+void terminate(NodeGraph& g, std::shared_ptr<Node> from) {
+    auto o = std::make_shared<OutputNode>();
+    g.addNode(o);
+    g.connectNodes(from->id, o->id);
+}
+
+// Returns the graph's input node.
+std::shared_ptr<InputNode> build(NodeGraph& g, const std::string& topology, const cv::Mat& img) {
+    auto in = std::make_shared<InputNode>();
+    in->setImage(img);
+    g.addNode(in);
+    if (topology == "linear") {
+        auto a = addBC(g, 10), b = addBlur(g, 5), c = addBC(g, -10);
+        g.connectNodes(in->id, a->id);
+        g.connectNodes(a->id, b->id);
+        g.connectNodes(b->id, c->id);
+        terminate(g, c);
+    } else if (topology == "fanout") {
+        for (int i = 0; i < 8; i++) {
+            auto b = addBlur(g, 2 + 3 * i), c = addBC(g, i);
+            g.connectNodes(in->id, b->id);
+            g.connectNodes(b->id, c->id);
+            terminate(g, c);
+        }
+    } else {
+        terminate(g, chain(g, in, 32));
+    }
+    return in;
+}
+
+// Cold: empty cache, every node recomputed. Warm: every node dirty again
+// but its fingerprint is already cached, as after reopening a graph.
+// Stream: no cache, as in node_batch, so intermediates are released as soon
+// as they are read and peak memory should track width, not depth.
+void graphSuite(const Options& opt, std::vector<Record>& out) {
+    for (double mp : opt.sizes) {
+        cv::Mat img = noise(mp, 3);
+        for (std::string topology : {"linear", "fanout", "deep"}) {
+            NodeGraph g;
+            auto in = build(g, topology, img);
+            for (std::string phase : {"cold", "warm", "stream"}) {
+                g.resultCache().setBudget(phase == "stream" ? 0 : size_t(8) << 30);
+                FramePool::instance().resetPeak();
+                Timing t = measure(opt.reps, [&]{
+                    if (phase == "cold") g.resultCache().clear();
+                    in->markDirty();
+                    g.evaluate();
+                });
+                Record rec;
+                rec.suite = "graph";
+                rec.name = topology + "_" + phase;
+                rec.width = img.cols;
+                rec.height = img.rows;
+                rec.channels = 3;
+                rec.nodes = int(g.nodes.size());
+                rec.reps = opt.reps;
+                rec.medianMs = t.median;
+                rec.minMs = t.min;
+                rec.peakMB = FramePool::instance().stats().peak / 1048576.0;
+                out.push_back(rec);
+            }
+        }
+    }
+}
+
+// === Graph bookkeeping at scale ===
+// Tiny frames so node work vanishes and what is left is wiring, invalidation
+// and scheduling. "chain" is one long path; "tree" fans out four ways per
+// level. Every edge is wired three times over, as interactive editing does.
+// Invalidating or editing a leaf should cost the same at any graph size.
+struct ScaleGraph {
+    NodeGraph g;
+    std::shared_ptr<InputNode> in;
+    std::shared_ptr<BrightnessContrastNode> leaf;
+};
+
+void buildScale(ScaleGraph& s, const std::string& topology, int count, const cv::Mat& img) {
+    s.in = std::make_shared<InputNode>();
+    s.in->setImage(img);
+    s.g.addNode(s.in);
+    std::vector<std::shared_ptr<Node>> all{s.in};
+    for (int i = 1; i < count; i++) {
+        std::shared_ptr<Node> n;
+        if (i % 2) n = addBlur(s.g, 1);
+        else n = s.leaf = std::static_pointer_cast<BrightnessContrastNode>(addBC(s.g, 5));
+        int from = topology == "chain" ? i - 1 : (i - 1) / 4;
+        for (int k = 0; k < 3; k++) s.g.connectNodes(all[from]->id, n->id);
+        all.push_back(n);
+    }
+    s.g.resultCache().setBudget(0);
+    s.g.setReleaseIntermediates(false);   // edited interactively, like the editor
+}
+
+void scaleSuite(const Options& opt, std::vector<Record>& out) {
+    cv::Mat img = noise(16 * 12 / 1e6, 3);
+    for (std::string topology : {"chain", "tree"}) {
+        std::unique_ptr<ScaleGraph> s;
+        std::vector<std::pair<std::string, Timing>> results;
+        results.push_back({"build", measure(opt.reps, [&]{
+            s = std::make_unique<ScaleGraph>();
+            buildScale(*s, topology, opt.nodes, img);
+        })});
+        ScaleGraph& sg = *s;
+        sg.g.evaluate();
+        auto clean = [&]{ sg.g.evaluate(); };
+        int v = 0;
+        results.push_back({"invalidate_root", measure(opt.reps, clean, [&]{ sg.in->markDirty(); })});
+        results.push_back({"invalidate_leaf", measure(opt.reps, clean, [&]{ sg.leaf->setBrightness(++v % 50); })});
+        results.push_back({"evaluate_clean", measure(opt.reps, clean, [&]{ sg.g.evaluate(); })});
+        results.push_back({"evaluate_leaf", measure(opt.reps, [&]{ sg.leaf->setBrightness(++v % 50); },
+                                                    [&]{ sg.g.evaluate(); })});
+        results.push_back({"evaluate_all", measure(opt.reps, [&]{ sg.in->markDirty(); },
+                                                   [&]{ sg.g.evaluate(); })});
+        for (auto& r : results) {
+            Record rec;
+            rec.suite = "scale";
+            rec.name = topology + "_" + r.first;
+            rec.width = img.cols;
+            rec.height = img.rows;
+            rec.channels = 3;
+            rec.nodes = int(sg.g.nodes.size());
+            rec.reps = opt.reps;
+            rec.medianMs = r.second.median;
+            rec.minMs = r.second.min;
+            out.push_back(rec);
+        }
+    }
+}
+
+// === SIMD kernels per ISA ===
+// Single-threaded so the numbers compare instruction sets, not core counts.
+// max_abs_diff is against the scalar variant and must be 0. The "opencv"
+// rows time the path each kernel replaced, convertTo for affine and a
+// scaled convertTo then addWeighted for mix. Against the scalar kernel they
+// may differ by 1: the old mix rounded twice, and convertTo may fuse its
+// multiply-add where the kernels never do.
+void simdSuite(const Options& opt, std::vector<Record>& out) {
+    std::vector<simd::Isa> isas;
+    for (auto isa : {simd::Isa::Scalar, simd::Isa::SSE42, simd::Isa::AVX2, simd::Isa::AVX512})
+        if (isa <= simd::detected()) isas.push_back(isa);
+    simd::Isa saved = simd::active();
+
+    for (double mp : opt.sizes) {
+        cv::Mat img = noise(mp, 3), other = noise(mp, 3);
+        cv::Mat accF, accI;
+        other.convertTo(accF, CV_32F, 17.0);
+        other.convertTo(accI, CV_32S, 17.0);
+        int n = img.cols * img.channels();
+
+        struct Kernel { const char* name; std::function<void(cv::Mat&)> run, opencv; };
+        cv::Mat blurred;
+        std::vector<Kernel> kernels = {
+            {"affine", [&](cv::Mat& d){
+                for (int y = 0; y < img.rows; y++)
+                    simd::affine(img.ptr<uchar>(y), d.ptr<uchar>(y), n, 1.3f, 20.0f);
+            }, [&](cv::Mat& d){ img.convertTo(d, -1, 1.3, 20.0); }},
+            {"mix_f32", [&](cv::Mat& d){
+                for (int y = 0; y < img.rows; y++)
+                    simd::mix(accF.ptr<float>(y), img.ptr<uchar>(y), d.ptr<uchar>(y), n, 0.6f/17, 0.4f);
+            }, [&](cv::Mat& d){
+                accF.convertTo(blurred, CV_8U, 1.0/17);
+                cv::addWeighted(blurred, 0.6, img, 0.4, 0, d);
+            }},
+            {"mix_s32", [&](cv::Mat& d){
+                for (int y = 0; y < img.rows; y++)
+                    simd::mix(accI.ptr<int32_t>(y), img.ptr<uchar>(y), d.ptr<uchar>(y), n, 0.6f/17, 0.4f);
+            }, [&](cv::Mat& d){
+                accI.convertTo(blurred, CV_8U, 1.0/17);
+                cv::addWeighted(blurred, 0.6, img, 0.4, 0, d);
+            }},
+        };
+        for (auto& k : kernels) {
+            cv::Mat expect(img.size(), img.type()), res(img.size(), img.type());
+            simd::setActive(simd::Isa::Scalar);
+            k.run(expect);
+            double scalarMs = 0;
+            for (int i = 0; i <= int(isas.size()); i++) {
+                bool opencv = i == int(isas.size());
+                if (!opencv) simd::setActive(isas[i]);
+                Timing t = measure(opt.reps, [&]{ (opencv ? k.opencv : k.run)(res); });
+                if (!opencv && isas[i] == simd::Isa::Scalar) scalarMs = t.median;
+                Record rec;
+                rec.suite = "simd";
+                rec.name = k.name;
+                rec.algorithm = opencv ? "opencv" : simd::name(isas[i]);
+                rec.width = img.cols;
+                rec.height = img.rows;
+                rec.channels = 3;
+                rec.reps = opt.reps;
+                rec.medianMs = t.median;
+                rec.minMs = t.min;
+                rec.maxAbsDiff = cv::norm(res, expect, cv::NORM_INF);
+                rec.tolerance = opencv ? 1 : 0;
+                rec.speedup = t.median > 0 ? scalarMs / t.median : 0;
+                out.push_back(rec);
+            }
+        }
+    }
+    simd::setActive(saved);
+}
+
+// === Time to first pixel ===
+// Opening a JPEG and evaluating a short graph at the proxy scale of a
+// 1920x1080 view, as the editor does. "full" decodes the whole file first;
+// "reduced" lets the decoder scale down to the proxy, the full decode that
+// follows it in the editor running in the background. speedup is full/reduced.
+void openSuite(const Options& opt, std::vector<Record>& out) {
+    std::string path = (std::filesystem::temp_directory_path() / "node_bench_open.jpg").string();
+    for (double mp : opt.sizes) {
+        // Upsampled noise compresses like a photograph; raw noise would not.
+        cv::Mat img;
+        cv::resize(noise(mp / 256, 3), img, cv::Size(), 16, 16, cv::INTER_CUBIC);
+        if (!cv::imwrite(path, img, {cv::IMWRITE_JPEG_QUALITY, 90}))
+            throw std::runtime_error("Cannot write " + path);
+        double scale = InputNode::proxyScaleFor(img.size(), cv::Size(1920, 1080));
+
+        NodeGraph g;
+        auto in = std::make_shared<InputNode>();
+        g.addNode(in);
+        auto bc = addBC(g, 10);
+        g.connectNodes(in->id, bc->id);
+        terminate(g, bc);
+        g.resultCache().setBudget(0);
+        g.setRenderScale(scale);
+
+        Timing full = measure(opt.reps, [&]{ in->loadImage(path); g.evaluate(); });
+        Timing reduced = measure(opt.reps, [&]{
+            if (!in->loadPreview(path, int(1 / scale), img.size())) in->loadImage(path);
+            g.evaluate();
+        });
+        auto record = [&](const char* mode, Timing t, double speedup) {
+            Record rec;
+            rec.suite = "open";
+            rec.name = "first_pixel";
+            rec.mode = mode;
+            rec.width = img.cols;
+            rec.height = img.rows;
+            rec.channels = 3;
+            rec.nodes = int(g.nodes.size());
+            rec.reps = opt.reps;
+            rec.medianMs = t.median;
+            rec.minMs = t.min;
+            rec.speedup = speedup;
+            out.push_back(rec);
+        };
+        record("full", full, -1);
+        record("reduced", reduced, full.median / reduced.median);
+    }
+    std::filesystem::remove(path);
+}
+
+// === Parameter sweep ===
+// Input -> blur -> blur -> brightness/contrast -> output, sweeping the
+// second blur's radius and the contrast. "serial" sets each combination on
+// the graph and re-evaluates, as scrubbing two sliders does; "sweep" runs
+// the grid through sweepParameters(). Both start from a cold cache with the
+// upstream blur already evaluated. speedup is serial/sweep.
+void sweepSuite(const Options& opt, std::vector<Record>& out) {
+    for (double mp : opt.sizes) {
+        cv::Mat img = noise(mp, 3);
+        NodeGraph g;
+        g.setReleaseIntermediates(false);
+        auto in = std::make_shared<InputNode>();
+        in->setImage(img);
+        g.addNode(in);
+        auto pre = addBlur(g, 8), swept = addBlur(g, 1), bc = addBC(g, 0);
+        g.connectNodes(in->id, pre->id);
+        g.connectNodes(pre->id, swept->id);
+        g.connectNodes(swept->id, bc->id);
+        terminate(g, bc);
+
+        std::vector<SweepAxis> axes(2);
+        axes[0].node = swept->id;
+        axes[0].param = "radius";
+        axes[0].values = SweepAxis::range(1, 15, 4);
+        axes[1].node = bc->id;
+        axes[1].param = "contrast";
+        axes[1].values = SweepAxis::range(0.6, 1.4, 4);
+        auto reset = [&]{
+            swept->setParam("radius", 1);
+            bc->setParam("contrast", 1.1);
+            g.evaluate();
+            g.resultCache().clear();
+        };
+
+        Timing serial = measure(opt.reps, reset, [&]{
+            for (double r : axes[0].values)
+                for (double c : axes[1].values) {
+                    swept->setParam("radius", r);
+                    bc->setParam("contrast", c);
+                    g.evaluate();
+                }
+        });
+        SweepOptions so;
+        so.cellWidth = 0;
+        Timing sweep = measure(opt.reps, reset, [&]{ sweepParameters(g, axes, so); });
+        auto record = [&](const char* mode, Timing t, double speedup) {
+            Record rec;
+            rec.suite = "sweep";
+            rec.name = "grid_4x4";
+            rec.mode = mode;
+            rec.width = img.cols;
+            rec.height = img.rows;
+            rec.channels = 3;
+            rec.nodes = int(g.nodes.size());
+            rec.reps = opt.reps;
+            rec.medianMs = t.median;
+            rec.minMs = t.min;
+            rec.speedup = speedup;
+            out.push_back(rec);
+        };
+        record("serial", serial, -1);
+        record("sweep", sweep, serial.median / sweep.median);
+    }
+}
+
+// === Recovery after a failure ===
+// Stands in for a file that breaks a node: throws on frames narrower than
+// 8 pixels and passes the rest through.
+class FailOnTiny : public Node {
+public:
+    FailOnTiny() : Node("Fail On Tiny") {
+        inputs.emplace_back(Port{Port::INPUT, Port::IMAGE, "Input"});
+        outputs.emplace_back(Port{Port::OUTPUT, Port::IMAGE, "Output"});
+    }
+    std::string typeName() const override { return "FailOnTiny"; }
+    void process() override {
+        if (!isDirty()) return;
+        if (inputData().size().width < 8) throw std::runtime_error("Frame too small");
+        outputs[0].data = inputData();
+        markClean();
+    }
+};
+
+// One bad frame, then good ones on the same graph, as a node_batch worker
+// sees them; the graph is deliberately not reset after the failure.
+// max_abs_diff compares each good result with a fresh graph's and must be
+// 0; anything else means a stale result leaked through.
+void recoverSuite(const Options& opt, std::vector<Record>& out) {
+    auto make = [](NodeGraph& g, std::shared_ptr<InputNode>& in, std::shared_ptr<OutputNode>& o) {
+        in = std::make_shared<InputNode>();
+        g.addNode(in);
+        auto blur = addBlur(g, 3);
+        auto check = std::make_shared<FailOnTiny>();
+        g.addNode(check);
+        auto bc = addBC(g, 10);
+        o = std::make_shared<OutputNode>();
+        g.addNode(o);
+        g.connectNodes(in->id, blur->id);
+        g.connectNodes(blur->id, check->id);
+        g.connectNodes(check->id, bc->id);
+        g.connectNodes(bc->id, o->id);
+        g.resultCache().setBudget(0);
+    };
+    for (double mp : opt.sizes) {
+        std::vector<cv::Mat> good{noise(mp, 3), noise(mp, 3)}, expected;
+        for (auto& img : good) {
+            NodeGraph fresh;
+            std::shared_ptr<InputNode> in;
+            std::shared_ptr<OutputNode> o;
+            make(fresh, in, o);
+            in->setImage(img);
+            fresh.evaluate();
+            expected.push_back(o->getResult().mat());
+        }
+
+        NodeGraph g;
+        std::shared_ptr<InputNode> in;
+        std::shared_ptr<OutputNode> o;
+        make(g, in, o);
+        cv::Mat bad(4, 4, CV_8UC3, cv::Scalar::all(0));
+        double worst = 0;
+        Timing t = measure(opt.reps, [&]{
+            in->setImage(bad);
+            try { g.evaluate(); } catch (const std::exception&) {}
+            for (size_t i = 0; i < good.size(); i++) {
+                in->setImage(good[i]);
+                g.evaluate();
+                const cv::Mat& r = o->getResult().mat();
+                worst = std::max(worst, r.size() == expected[i].size()
+                                        ? cv::norm(r, expected[i], cv::NORM_INF) : 255.0);
+            }
+        });
+        Record rec;
+        rec.suite = "recover";
+        rec.name = "after_failure";
+        rec.width = good[0].cols;
+        rec.height = good[0].rows;
+        rec.channels = 3;
+        rec.nodes = int(g.nodes.size());
+        rec.reps = opt.reps;
+        rec.medianMs = t.median;
+        rec.minMs = t.min;
+        rec.maxAbsDiff = worst;
+        rec.tolerance = 0;
+        out.push_back(rec);
+    }
+}
+
+// === Output ===
+double mpPerSec(const Record& r) {
+    return r.medianMs > 0 ? double(r.width) * r.height / 1e6 / (r.medianMs / 1e3) : 0;
+}
+
+void writeJson(std::ostream& os, const std::vector<Record>& recs) {
+    os << "[\n";
+    for (size_t i = 0; i < recs.size(); i++) {
+        auto& r = recs[i];
+        char buf[160];
+        os << "  {\"suite\": \"" << r.suite << "\", \"name\": \"" << r.name << "\"";
+        if (!r.algorithm.empty()) os << ", \"algorithm\": \"" << r.algorithm << "\"";
+        if (!r.mode.empty())      os << ", \"mode\": \"" << r.mode << "\"";
+        os << ", \"width\": " << r.width << ", \"height\": " << r.height
+           << ", \"channels\": " << r.channels;
+        if (r.radius) os << ", \"radius\": " << r.radius;
+        if (r.nodes)  os << ", \"nodes\": " << r.nodes;
+        std::snprintf(buf, sizeof buf, ", \"reps\": %d, \"median_ms\": %.3f, \"min_ms\": %.3f, \"mp_per_s\": %.2f",
+                      r.reps, r.medianMs, r.minMs, mpPerSec(r));
+        os << buf;
+        if (r.maxAbsDiff >= 0) os << ", \"max_abs_diff\": " << r.maxAbsDiff;
+        if (r.speedup >= 0)    os << ", \"speedup\": " << r.speedup;
+        if (r.peakMB >= 0)     os << ", \"peak_mb\": " << r.peakMB;
+        if (r.tolerance >= 0)  os << ", \"tolerance\": " << r.tolerance;
+        os << "}" << (i + 1 < recs.size() ? "," : "") << "\n";
+    }
+    os << "]\n";
+}
+
+void writeCsv(std::ostream& os, const std::vector<Record>& recs) {
+    os << "suite,name,algorithm,mode,width,height,channels,radius,nodes,reps,median_ms,min_ms,mp_per_s,max_abs_diff,speedup,peak_mb,tolerance\n";
+    for (auto& r : recs) {
+        char buf[160];
+        std::snprintf(buf, sizeof buf, "%d,%d,%d,%d,%d,%d,%.3f,%.3f,%.2f,",
+                      r.width, r.height, r.channels, r.radius, r.nodes, r.reps,
+                      r.medianMs, r.minMs, mpPerSec(r));
+        os << r.suite << "," << r.name << "," << r.algorithm << "," << r.mode << "," << buf;
+        if (r.maxAbsDiff >= 0) os << r.maxAbsDiff;
+        os << ",";
+        if (r.speedup >= 0) os << r.speedup;
+        os << ",";
+        if (r.peakMB >= 0) os << r.peakMB;
+        os << ",";
+        if (r.tolerance >= 0) os << r.tolerance;
+        os << "\n";
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse(argc, argv, opt)) { usage(); return 2; }
+
+    std::vector<Record> recs;
+    try {
+        if (wants(opt, "node"))   nodeSuite(opt, recs);
+        if (wants(opt, "kernel")) kernelSuite(opt, recs);
+        if (wants(opt, "graph"))  graphSuite(opt, recs);
+        if (wants(opt, "simd"))   simdSuite(opt, recs);
+        if (wants(opt, "scale"))  scaleSuite(opt, recs);
+        if (wants(opt, "open"))   openSuite(opt, recs);
+        if (wants(opt, "sweep"))  sweepSuite(opt, recs);
+        if (wants(opt, "recover")) recoverSuite(opt, recs);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!opt.out.empty()) {
+        file.open(opt.out);
+        if (!file) { std::fprintf(stderr, "Cannot write %s\n", opt.out.c_str()); return 1; }
+    }
+    std::ostream& os = opt.out.empty() ? std::cout : file;
+    if (opt.format == "csv") writeCsv(os, recs);
+    else writeJson(os, recs);
+
+    int failures = 0;
+    for (auto& r : recs)
+        if (r.tolerance >= 0 && r.maxAbsDiff > r.tolerance) {
+            std::fprintf(stderr, "FAIL %s %s %s %s %dx%dx%d r%d: max_abs_diff %g exceeds %g\n",
+                         r.suite.c_str(), r.name.c_str(), r.algorithm.c_str(), r.mode.c_str(),
+                         r.width, r.height, r.channels, r.radius, r.maxAbsDiff, r.tolerance);
+            failures++;
+        }
+    return failures ? 1 : 0;
+}
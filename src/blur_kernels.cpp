@@ -0,0 +1,149 @@
+#include "blur_kernels.h"
+#include <algorithm>
+#include "frame_pool.h"
+#include "simd_kernels.h"
+
+namespace blur {
+
+namespace {
+
+// out = saturate(acc*scale + in*keep) in one pass, where acc holds the
+// unnormalised blur in float.
+void mixInto(const cv::Mat& acc, float scale, const cv::Mat& in, float keep, cv::Mat& out) {
+    if (out.data == in.data) out.release();
+    if (in.depth() != CV_8U) {
+        cv::Mat src;
+        in.convertTo(src, CV_32F);
+        cv::addWeighted(acc, scale, src, keep, 0, out, in.depth());
+        return;
+    }
+    out.create(in.size(), in.type());
+    int n = in.cols * in.channels();
+    cv::parallel_for_(cv::Range(0, in.rows), [&](const cv::Range& rows){
+        for (int y = rows.start; y < rows.end; y++)
+            simd::mix(acc.ptr<float>(y), in.ptr<uchar>(y), out.ptr<uchar>(y), n, scale, keep);
+    });
+}
+
+void separableGaussian(const cv::Mat& in, cv::Mat& out, int r, float amount) {
+    cv::Mat g = cv::getGaussianKernel(2*r+1, -1, CV_32F);
+    if (amount >= 1.0f) {
+        cv::sepFilter2D(in, out, -1, g, g);
+        return;
+    }
+    cv::Mat acc = FramePool::mat();
+    cv::sepFilter2D(in, acc, CV_32F, g, g);
+    mixInto(acc, amount, in, 1.0f-amount, out);
+}
+
+// Three box widths whose cascade has the variance of the Gaussian that
+// getGaussianKernel(2r+1, -1) builds (sigma = 0.3*(r-1) + 0.8).
+void boxWidths(int r, int w[3]) {
+    double sigma = 0.3*(r-1) + 0.8, var12 = 12*sigma*sigma;
+    int wl = int(std::floor(std::sqrt(var12/3 + 1)));
+    if (wl % 2 == 0) wl--;
+    int m = cvRound((var12 - 3*wl*wl - 12*wl - 9) / (-4.0*wl - 4));
+    for (int i = 0; i < 3; i++) w[i] = i < m ? wl : wl+2;
+}
+
+void boxCascade(const cv::Mat& in, cv::Mat& out, int r, float amount) {
+    int w[3];
+    boxWidths(r, w);
+    cv::Mat a = FramePool::mat(), b = FramePool::mat();
+    cv::boxFilter(in, a, CV_32F, {w[0], w[0]});
+    cv::boxFilter(a, b, -1, {w[1], w[1]});
+    cv::boxFilter(b, a, -1, {w[2], w[2]});
+    mixInto(a, amount, in, 1.0f-amount, out);
+}
+
+// Sums the input shifted by every tap, row by row, and mixes straight into
+// the output row while it is still in cache.
+void lineIntegral(const cv::Mat& in, cv::Mat& out, int r, float angle, float amount) {
+    std::vector<cv::Point> taps = lineTaps(r, angle);
+    float scale = amount / float(taps.size()), keep = 1.0f - amount;
+    cv::Mat padded = FramePool::mat();
+    cv::copyMakeBorder(in, padded, r, r, r, r, cv::BORDER_REFLECT_101);
+
+    if (in.depth() != CV_8U) {
+        cv::Mat acc = cv::Mat::zeros(in.size(), CV_MAKETYPE(CV_32F, in.channels()));
+        for (auto& t : taps) cv::accumulate(padded(cv::Rect(r+t.x, r+t.y, in.cols, in.rows)), acc);
+        mixInto(acc, scale, in, keep, out);
+        return;
+    }
+    if (out.data == in.data) out.release();
+    out.create(in.size(), in.type());
+    int cn = in.channels(), n = in.cols * cn;
+    cv::parallel_for_(cv::Range(0, in.rows), [&](const cv::Range& rows){
+        std::vector<int> acc(n);
+        for (int y = rows.start; y < rows.end; y++) {
+            std::fill(acc.begin(), acc.end(), 0);
+            for (auto& t : taps) {
+                const uchar* s = padded.ptr<uchar>(y + r + t.y) + (r + t.x)*cn;
+                for (int x = 0; x < n; x++) acc[x] += s[x];
+            }
+            simd::mix(acc.data(), in.ptr<uchar>(y), out.ptr<uchar>(y), n, scale, keep);
+        }
+    });
+}
+
+void reference(const cv::Mat& in, cv::Mat& out, bool directional, int r, float angle, float amount) {
+    cv::Mat blurred;
+    int k = r*2+1;
+    if (!directional)
+        cv::GaussianBlur(in, blurred, {k,k}, 0);
+    else
+        cv::filter2D(in, blurred, -1, kernel2D(r, true, angle));
+    cv::addWeighted(blurred, amount, in, 1.0f-amount, 0, out);
+}
+
+}
+
+Algorithm choose(bool directional, int radius) {
+    if (directional) return Algorithm::LineIntegral;
+    return radius > kBoxCascadeRadius ? Algorithm::BoxCascade : Algorithm::SeparableGaussian;
+}
+
+std::vector<cv::Point> lineTaps(int radius, float angleDeg) {
+    int k = radius*2+1;
+    float rads = angleDeg * CV_PI/180.0f;
+    float dx = std::cos(rads), dy = std::sin(rads);
+    std::vector<cv::Point> taps;
+    for (int i = 0; i < k; i++) {
+        float t = i-(k-1)/2.0f;
+        int x = int(std::round(radius + dx*t)), y = int(std::round(radius + dy*t));
+        if (x < 0 || x >= k || y < 0 || y >= k) continue;
+        cv::Point p(x - radius, y - radius);
+        if (std::find(taps.begin(), taps.end(), p) == taps.end()) taps.push_back(p);
+    }
+    return taps;
+}
+
+cv::Mat kernel2D(int radius, bool directional, float angleDeg) {
+    int k = radius*2+1;
+    if (!directional) {
+        cv::Mat g = cv::getGaussianKernel(k,-1,CV_32F);
+        return g * g.t();
+    }
+    cv::Mat M = cv::Mat::zeros(k,k,CV_32F);
+    std::vector<cv::Point> taps = lineTaps(radius, angleDeg);
+    for (auto& p : taps) M.at<float>(p.y + radius, p.x + radius) = 1;
+    return M / double(taps.size());
+}
+
+void apply(const cv::Mat& in, cv::Mat& out, Algorithm algo, bool directional,
+           int radius, float angleDeg, float amount) {
+    if (amount <= 0.0f) { out = in; return; }
+    switch (algo) {
+    case Algorithm::Reference:         reference(in, out, directional, radius, angleDeg, amount); break;
+    case Algorithm::SeparableGaussian: separableGaussian(in, out, radius, amount); break;
+    case Algorithm::BoxCascade:        boxCascade(in, out, radius, amount); break;
+    case Algorithm::LineIntegral:      lineIntegral(in, out, radius, angleDeg, amount); break;
+    }
+}
+
+void apply(const cv::Mat& in, cv::Mat& out, bool directional,
+           int radius, float angleDeg, float amount) {
+    apply(in, out, choose(directional, radius), directional, radius, angleDeg, amount);
+}
+
+}
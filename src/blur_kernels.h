@@ -0,0 +1,36 @@
+// ----------------- blur_kernels.h -----------------
+#pragma once
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Blur engine behind BlurNode. Each algorithm's per-pixel cost stays
+// constant or linear in the radius, and the `amount` mix with the input is
+// fused into the final pass instead of a separate addWeighted.
+namespace blur {
+
+enum class Algorithm {
+    Reference,          // dense 2-D kernel + addWeighted (the original path)
+    SeparableGaussian,  // two 1-D passes, O(r) per pixel
+    BoxCascade,         // three running-sum boxes approximating the Gaussian, O(1)
+    LineIntegral,       // shifted accumulation along the blur direction, O(r)
+};
+
+// Above this radius UNIFORM switches from the exact separable Gaussian to
+// the box cascade.
+constexpr int kBoxCascadeRadius = 12;
+
+Algorithm choose(bool directional, int radius);
+
+// Pixel offsets covered by the directional kernel, one per distinct tap.
+std::vector<cv::Point> lineTaps(int radius, float angleDeg);
+// Dense kernel matching the original getKernel(); for previews and the
+// reference path.
+cv::Mat kernel2D(int radius, bool directional, float angleDeg);
+
+void apply(const cv::Mat& in, cv::Mat& out, Algorithm algo, bool directional,
+           int radius, float angleDeg, float amount);
+// Picks the algorithm with choose().
+void apply(const cv::Mat& in, cv::Mat& out, bool directional,
+           int radius, float angleDeg, float amount);
+
+}
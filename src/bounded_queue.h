@@ -0,0 +1,65 @@
+// ----------------- bounded_queue.h -----------------
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// Blocking FIFO with a fixed capacity, used to connect pipeline stages so a
+// fast producer can't run arbitrarily far ahead of a slow consumer.
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+    // Blocks while full. Returns false if the queue was closed.
+    bool push(T value) {
+        std::unique_lock<std::mutex> lk(m);
+        notFull.wait(lk, [this]{ return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(value));
+        notEmpty.notify_one();
+        return true;
+    }
+    // Blocks while empty. Returns false once closed and drained.
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> lk(m);
+        notEmpty.wait(lk, [this]{ return closed || !items.empty(); });
+        if (items.empty()) return false;
+        out = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+    // Takes out and returns the queued items matching `pred`, e.g.
+    // requests nobody waits for any more.
+    template<typename Pred>
+    std::vector<T> removeIf(Pred pred) {
+        std::vector<T> out;
+        std::lock_guard<std::mutex> lk(m);
+        for (auto it = items.begin(); it != items.end(); ) {
+            if (pred(*it)) {
+                out.push_back(std::move(*it));
+                it = items.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (!out.empty()) notFull.notify_all();
+        return out;
+    }
+    // Producers are done; consumers drain what's left and then stop.
+    void close() {
+        std::lock_guard<std::mutex> lk(m);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    std::mutex m;
+    std::condition_variable notEmpty, notFull;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
@@ -0,0 +1,88 @@
+#include "eval_worker.h"
+#include "thread_pool.h"
+#include "tiled_renderer.h"
+
+EvalWorker::EvalWorker(NodeGraph& graph, QObject* parent)
+  : QObject(parent), graph(graph)
+{
+    qRegisterMetaType<Frame>("Frame");
+    thread = std::thread([this]{ loop(); });
+}
+
+EvalWorker::~EvalWorker() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+quint64 EvalWorker::submit(Edit edit) {
+    quint64 gen;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (edit) edits.push_back(std::move(edit));
+        gen = ++generation;
+    }
+    wake.notify_one();
+    return gen;
+}
+
+void EvalWorker::setSpeculation(std::shared_ptr<Node> node, const std::string& param,
+                                std::vector<double> values) {
+    specNode = std::move(node);
+    specParam = param;
+    specValues = std::move(values);
+}
+
+// Tiles covering just the zoomed-in view, pulled at source resolution; skipped
+// if a newer request is already waiting.
+void EvalWorker::renderDetail(quint64 gen) {
+    cv::Rect r = detail & cv::Rect(cv::Point(0,0), output->outputSize());
+    if (r.empty() || generation != gen) return;
+    cv::Mat px = TiledRenderer(ThreadPool::instance()).render(output.get(), r);
+    if (!px.empty())
+        emit detailReady(Frame(px, output->channelOrder()), QRect(r.x, r.y, r.width, r.height), gen);
+}
+
+void EvalWorker::loop() {
+    for (;;) {
+        std::vector<Edit> batch;
+        quint64 gen;
+        {
+            std::unique_lock<std::mutex> lk(m);
+            wake.wait(lk, [this]{ return stopping || generation != evaluated; });
+            if (stopping) return;
+            batch.swap(edits);
+            gen = generation;
+        }
+        evaluated = gen;
+        // Its copies no longer match the graph the edits are about to change.
+        speculator.stop();
+        for (auto& e : batch) {
+            try { e(); }
+            catch (const std::exception& ex) { emit failed(QString::fromStdString(ex.what())); }
+        }
+        try {
+            // Bail out between nodes as soon as a newer request arrives; the
+            // nodes left dirty are picked up by the next pass.
+            bool done = graph.evaluate([this, gen]{
+                return generation != gen || stopping;
+            });
+            if (done && output) {
+                emit resultReady(output->getResult(), gen);
+                renderDetail(gen);
+            }
+            // Idle cores guess the next values; results a worker process
+            // produces never pass through the local cache, so not then.
+            if (done && specNode && !graph.processPool()) {
+                speculator.start(graph, specNode->id, specParam, specValues, [this, gen]{
+                    return generation != gen || stopping;
+                });
+            }
+        } catch (const std::exception& ex) {
+            emit failed(QString::fromStdString(ex.what()));
+        }
+    }
+}
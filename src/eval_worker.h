@@ -0,0 +1,67 @@
+// ----------------- eval_worker.h -----------------
+#pragma once
+#include <QObject>
+#include <QRect>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "node_framework.h"
+#include "param_sweep.h"
+
+Q_DECLARE_METATYPE(Frame)
+
+// Owns all access to a NodeGraph from a background thread. The GUI never
+// touches nodes directly: it submits edits, which are applied in order on
+// the worker between evaluations. A new submission cancels the evaluation in
+// flight, and bursts of edits collapse into one evaluation of the latest state.
+class EvalWorker : public QObject {
+    Q_OBJECT
+public:
+    using Edit = std::function<void()>;
+
+    explicit EvalWorker(NodeGraph& graph, QObject* parent=nullptr);
+    ~EvalWorker() override;
+
+    // Returns the generation whose result will reflect this edit.
+    quint64 submit(Edit edit = {});
+    // Only call from inside an edit; selects the node whose result is posted.
+    void setOutput(std::shared_ptr<OutputNode> node) { output = std::move(node); }
+    // Only call from inside an edit; after each evaluation, `region` of the
+    // output (in source pixels) is also rendered at full resolution.
+    void setDetail(const cv::Rect& region) { detail = region; }
+    // Only call from inside an edit; whenever an evaluation finishes with
+    // nothing newer waiting, results for `node`'s `param` at each of
+    // `values`, nearest first, are precomputed into the graph's cache. The
+    // values should be exactly what the control would set next. A null
+    // node turns this off.
+    void setSpeculation(std::shared_ptr<Node> node, const std::string& param = {},
+                        std::vector<double> values = {});
+
+signals:
+    void resultReady(const Frame& result, quint64 generation);
+    void detailReady(const Frame& detail, const QRect& region, quint64 generation);
+    void failed(const QString& message);
+
+private:
+    void loop();
+    void renderDetail(quint64 gen);
+
+    NodeGraph& graph;
+    std::shared_ptr<OutputNode> output;
+    cv::Rect detail;
+    std::shared_ptr<Node> specNode;
+    std::string specParam;
+    std::vector<double> specValues;
+    Speculator speculator;
+    std::mutex m;
+    std::condition_variable wake;
+    std::vector<Edit> edits;
+    std::atomic<quint64> generation{0};
+    quint64 evaluated = 0;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
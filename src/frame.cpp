@@ -0,0 +1,42 @@
+#include "frame.h"
+
+namespace {
+std::atomic<uint64_t> copyCount{0};
+std::atomic<uint64_t> copyBytes{0};
+thread_local Frame::CopyCounter* scopeCounter = nullptr;
+}
+
+cv::Mat Frame::copyOf(const cv::Mat& src) {
+    size_t bytes = src.total() * src.elemSize();
+    copyCount++;
+    copyBytes += bytes;
+    if (scopeCounter) {
+        scopeCounter->copies++;
+        scopeCounter->bytesCopied += bytes;
+    }
+    return src.clone();
+}
+
+Frame::Stats Frame::stats() {
+    Stats s;
+    s.copies = copyCount;
+    s.bytesCopied = copyBytes;
+    return s;
+}
+
+void Frame::resetStats() {
+    copyCount = 0;
+    copyBytes = 0;
+}
+
+Frame::CopyScope::CopyScope(CopyCounter* counter) : outer(scopeCounter) { scopeCounter = counter; }
+
+Frame::CopyScope::~CopyScope() { scopeCounter = outer; }
+
+cv::Mat toBgr(const cv::Mat& pixels, ChannelOrder order) {
+    int cn = pixels.channels();
+    if (order == ChannelOrder::BGR || (cn != 3 && cn != 4)) return pixels;
+    cv::Mat bgr;
+    cv::cvtColor(pixels, bgr, cn == 4 ? cv::COLOR_RGBA2BGRA : cv::COLOR_RGB2BGR);
+    return bgr;
+}
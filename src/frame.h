@@ -0,0 +1,66 @@
+// ----------------- frame.h -----------------
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+// Byte order of 3- and 4-channel pixels. Decoders produce BGR and the
+// built-in nodes treat channels alike, so the order travels with the frame
+// and is only resolved where pixels leave the graph (display, encode).
+enum class ChannelOrder { RGB, BGR };
+
+// Immutable, ref-counted image passed between ports. Copying a Frame shares
+// the pixel buffer; the only ways to get a private buffer are writable() and
+// clone(), and both are counted so an unchanged path can be shown to move
+// zero full frames.
+class Frame {
+public:
+    struct Stats { uint64_t copies = 0, bytesCopied = 0; };
+
+    Frame() = default;
+    Frame(const cv::Mat& m, ChannelOrder order = ChannelOrder::RGB) : m(m), o(order) {}
+
+    const cv::Mat& mat() const { return m; }
+    bool empty() const { return m.empty(); }
+    cv::Size size() const { return m.size(); }
+    int type() const { return m.type(); }
+    size_t bytes() const { return m.empty() ? 0 : m.total() * m.elemSize(); }
+    ChannelOrder order() const { return o; }
+
+    // True if another Frame or cv::Mat can observe this buffer.
+    bool shared() const { return !m.u || m.u->refcount > 1; }
+    // Detaches before handing out a mutable view; a no-op when this Frame
+    // is the buffer's sole owner.
+    cv::Mat& writable() {
+        if (!m.empty() && shared()) m = copyOf(m);
+        return m;
+    }
+    Frame clone() const { return m.empty() ? Frame() : Frame(copyOf(m), o); }
+
+    // Process-wide; every graph and thread adds to the same counts.
+    static Stats stats();
+    static void resetStats();
+
+    // Copies made on a thread while a CopyScope lives there are also added
+    // to its counter, so one evaluation can count its own while others run
+    // alongside. Scopes nest; the innermost one counts.
+    struct CopyCounter { std::atomic<uint64_t> copies{0}, bytesCopied{0}; };
+    class CopyScope {
+    public:
+        explicit CopyScope(CopyCounter* counter);
+        ~CopyScope();
+        CopyScope(const CopyScope&) = delete;
+        CopyScope& operator=(const CopyScope&) = delete;
+    private:
+        CopyCounter* outer;
+    };
+
+private:
+    static cv::Mat copyOf(const cv::Mat& src);
+    cv::Mat m;
+    ChannelOrder o = ChannelOrder::RGB;
+};
+
+// Pixels in OpenCV's BGR(A) order for imwrite and friends; shares the
+// buffer when they already are.
+cv::Mat toBgr(const cv::Mat& pixels, ChannelOrder order);
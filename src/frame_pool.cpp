@@ -0,0 +1,112 @@
+#include "frame_pool.h"
+#include <algorithm>
+
+// Never destroyed: pooled Mats may outlive every other static.
+FramePool& FramePool::instance() {
+    static FramePool* pool = new FramePool;
+    return *pool;
+}
+
+cv::Mat FramePool::mat() {
+    cv::Mat m;
+    m.allocator = &instance();
+    return m;
+}
+
+void FramePool::setBudget(size_t idleBytes) {
+    std::lock_guard<std::mutex> lk(m);
+    budget = idleBytes;
+    evictToFit();
+}
+
+void FramePool::trim() {
+    std::lock_guard<std::mutex> lk(m);
+    for (auto& e : released) cv::fastFree(e.second);
+    released.clear();
+    idle.clear();
+    s.idle = 0;
+}
+
+FramePool::Stats FramePool::stats() const {
+    std::lock_guard<std::mutex> lk(m);
+    return s;
+}
+
+void FramePool::resetPeak() {
+    std::lock_guard<std::mutex> lk(m);
+    s.peak = s.live;
+}
+
+// Same layout rules as OpenCV's standard allocator; only where the bytes
+// come from differs.
+cv::UMatData* FramePool::allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+                                  cv::AccessFlag, cv::UMatUsageFlags) const {
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data0 && step[i] != CV_AUTOSTEP) total = step[i];
+            else step[i] = total;
+        }
+        total *= sizes[i];
+    }
+    auto* u = new cv::UMatData(this);
+    u->size = total;
+    if (data0) {
+        u->data = u->origdata = static_cast<uchar*>(data0);
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+        return u;
+    }
+    uchar* data = nullptr;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        auto it = idle.find(total);
+        if (it != idle.end() && !it->second.empty()) {
+            data = it->second.back();
+            it->second.pop_back();
+            released.erase(std::find(released.begin(), released.end(), std::make_pair(total, data)));
+            s.idle -= total;
+            s.hits++;
+        } else {
+            s.misses++;
+        }
+        s.live += total;
+        s.peak = std::max(s.peak, s.live);
+    }
+    u->data = u->origdata = data ? data : static_cast<uchar*>(cv::fastMalloc(total));
+    return u;
+}
+
+bool FramePool::allocate(cv::UMatData* u, cv::AccessFlag, cv::UMatUsageFlags) const {
+    return u != nullptr;
+}
+
+void FramePool::deallocate(cv::UMatData* u) const {
+    if (!u) return;
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+        std::lock_guard<std::mutex> lk(m);
+        s.live -= u->size;
+        if (u->size <= budget) {
+            idle[u->size].push_back(u->origdata);
+            released.emplace_back(u->size, u->origdata);
+            s.idle += u->size;
+            evictToFit();
+        } else {
+            cv::fastFree(u->origdata);
+        }
+        u->origdata = nullptr;
+    }
+    delete u;
+}
+
+void FramePool::evictToFit() const {
+    while (s.idle > budget && !released.empty()) {
+        auto [size, data] = released.front();
+        released.pop_front();
+        auto& list = idle[size];
+        list.erase(std::find(list.begin(), list.end(), data));
+        cv::fastFree(data);
+        s.idle -= size;
+    }
+}
@@ -0,0 +1,45 @@
+// ----------------- frame_pool.h -----------------
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Recycles pixel buffers by byte size. A Mat from FramePool::mat() hands its
+// buffer back here when the last reference goes, and the next create() of
+// the same size and type reuses it instead of going to the heap. Idle
+// buffers are kept up to a byte budget, oldest dropped first.
+class FramePool : public cv::MatAllocator {
+public:
+    struct Stats {
+        uint64_t hits = 0, misses = 0;
+        size_t live = 0, peak = 0, idle = 0;   // bytes in use, high-water mark, waiting for reuse
+    };
+
+    static FramePool& instance();
+    // An empty Mat whose buffers come from the shared pool.
+    static cv::Mat mat();
+
+    void setBudget(size_t idleBytes);
+    // Frees every idle buffer.
+    void trim();
+    Stats stats() const;
+    // Starts a new high-water mark from what is live now.
+    void resetPeak();
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usage) const override;
+    bool allocate(cv::UMatData* u, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override;
+    void deallocate(cv::UMatData* u) const override;
+
+private:
+    void evictToFit() const;
+
+    mutable std::mutex m;
+    mutable std::unordered_map<size_t, std::vector<uchar*>> idle;   // by byte size
+    mutable std::deque<std::pair<size_t, uchar*>> released;         // oldest first
+    mutable Stats s;
+    size_t budget = size_t(1) << 30;
+};
@@ -0,0 +1,188 @@
+#include "frame_stream.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string lowerExtension(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return char(std::tolower(c)); });
+    return ext;
+}
+
+bool readFile(const std::string& path, std::vector<uchar>& out) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f) return false;
+    out.resize(size_t(f.tellg()));
+    f.seekg(0);
+    return bool(f.read(reinterpret_cast<char*>(out.data()), std::streamsize(out.size())));
+}
+
+bool isVideoFile(const std::string& path) {
+    static const char* exts[] = {".mp4", ".mov", ".avi", ".mkv", ".webm", ".m4v", ".mpg", ".mpeg"};
+    std::string ext = lowerExtension(path);
+    return std::any_of(std::begin(exts), std::end(exts), [&](const char* e){ return ext == e; });
+}
+
+int fourccFor(const std::string& path) {
+    std::string ext = lowerExtension(path);
+    if (ext == ".avi") return cv::VideoWriter::fourcc('M','J','P','G');
+    if (ext == ".webm") return cv::VideoWriter::fourcc('V','P','8','0');
+    return cv::VideoWriter::fourcc('m','p','4','v');
+}
+
+}
+
+bool isStreamSource(const std::string& path) {
+    return path.find('%') != std::string::npos || path.find('*') != std::string::npos
+        || fs::is_directory(path) || isVideoFile(path);
+}
+
+// === FrameReader ===
+FrameReader::FrameReader(const std::string& source, size_t depth) : queue(depth) {
+    if (fs::is_directory(source)) {
+        for (auto& e : fs::directory_iterator(source))
+            if (e.is_regular_file()) files.push_back(e.path().string());
+        std::sort(files.begin(), files.end());
+    } else if (source.find('*') != std::string::npos) {
+        cv::glob(source, files, false);
+    } else {
+        // Handles video files and printf-style sequences alike.
+        if (!cap.open(source)) throw std::runtime_error("Cannot open stream " + source);
+        rate = cap.get(cv::CAP_PROP_FPS);
+        double n = cap.get(cv::CAP_PROP_FRAME_COUNT);
+        count = n > 0 ? int(n) : -1;
+    }
+    if (!cap.isOpened()) {
+        if (files.empty()) throw std::runtime_error("No frames match " + source);
+        count = int(files.size());
+    }
+    if (rate <= 0) rate = 25;
+    thread = std::thread([this]{ run(); });
+}
+
+FrameReader::~FrameReader() {
+    queue.close();
+    thread.join();
+}
+
+bool FrameReader::next(Frame& frame) {
+    return queue.pop(frame);
+}
+
+// A buffer is free once the pool holds the only reference to it, or none
+// at all after a failed decode. Consumers drop references on other threads,
+// so the count is read atomically, as OpenCV itself updates it.
+cv::Mat& FrameReader::acquire() {
+    for (auto& b : buffers)
+        if (!b.u || CV_XADD(&b.u->refcount, 0) == 1) return b;
+    buffers.emplace_back();
+    return buffers.back();
+}
+
+void FrameReader::run() {
+    std::vector<uchar> bytes;
+    for (size_t i = 0;; i++) {
+        cv::Mat& dst = acquire();
+        // Either way decodes straight into the recycled buffer when the size
+        // is unchanged.
+        if (cap.isOpened()) {
+            if (!cap.read(dst)) break;
+        } else {
+            if (i >= files.size()) break;
+            if (!readFile(files[i], bytes) || cv::imdecode(bytes, cv::IMREAD_COLOR, &dst).empty()) {
+                skippedFiles++;
+                continue;
+            }
+        }
+        if (!queue.push(Frame(dst, ChannelOrder::BGR))) break;
+    }
+    queue.close();
+}
+
+// === FrameWriter ===
+FrameWriter::FrameWriter(const std::string& dest, double fps, size_t depth)
+  : dest(dest), rate(fps > 0 ? fps : 25), sequence(dest.find('%') != std::string::npos), queue(depth)
+{
+    if (!sequence && !isVideoFile(dest))
+        throw std::runtime_error("Output must be a video file or a %d sequence: " + dest);
+    if (sequence) {
+        // The index goes in by hand, so the name is never a printf format:
+        // exactly one %d, %Nd or %0Nd, and %% for a literal percent.
+        bool found = false;
+        std::string* part = &before;
+        for (size_t i = 0; i < dest.size(); i++) {
+            if (dest[i] != '%') { *part += dest[i]; continue; }
+            if (i + 1 < dest.size() && dest[i + 1] == '%') { *part += '%'; i++; continue; }
+            size_t j = i + 1;
+            if (j < dest.size() && dest[j] == '0') { pad = '0'; j++; }
+            for (; j < dest.size() && std::isdigit(static_cast<unsigned char>(dest[j])); j++)
+                width = std::min(width * 10 + (dest[j] - '0'), 64);
+            if (found || j >= dest.size() || dest[j] != 'd') { found = false; break; }
+            found = true;
+            part = &after;
+            i = j;
+        }
+        if (!found) throw std::runtime_error("Sequence needs exactly one %d and no other % conversion: " + dest);
+    }
+    thread = std::thread([this]{ run(); });
+}
+
+FrameWriter::~FrameWriter() {
+    queue.close();
+    if (thread.joinable()) thread.join();
+}
+
+void FrameWriter::write(const Frame& frame) {
+    if (!frame.empty()) queue.push(frame);
+}
+
+void FrameWriter::close() {
+    queue.close();
+    if (thread.joinable()) thread.join();
+    video.release();
+    std::lock_guard<std::mutex> lk(m);
+    if (!error.empty()) throw std::runtime_error(error);
+}
+
+void FrameWriter::run() {
+    Frame f;
+    while (queue.pop(f)) {
+        try {
+            encode(f);
+            written++;
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lk(m);
+            if (error.empty()) error = e.what();
+        }
+        f = Frame();   // drop the reference before blocking on the next pop
+    }
+}
+
+void FrameWriter::encode(const Frame& frame) {
+    // Sequences keep alpha and grey; video containers take 3-channel BGR.
+    const cv::Mat& px = frame.mat();
+    int cn = px.channels(), code = -1;
+    bool rgb = frame.order() == ChannelOrder::RGB;
+    if (cn == 1)      code = sequence ? -1 : cv::COLOR_GRAY2BGR;
+    else if (cn == 3) code = rgb ? cv::COLOR_RGB2BGR : -1;
+    else if (cn == 4) code = sequence ? (rgb ? cv::COLOR_RGBA2BGRA : -1)
+                                      : (rgb ? cv::COLOR_RGBA2BGR : cv::COLOR_BGRA2BGR);
+    if (code >= 0) cv::cvtColor(px, bgr, code);
+    const cv::Mat& out = code >= 0 ? bgr : px;
+    if (sequence) {
+        std::string index = std::to_string(written);
+        if (int(index.size()) < width) index.insert(0, width - index.size(), pad);
+        std::string name = before + index + after;
+        if (!cv::imwrite(name, out)) throw std::runtime_error("Failed to write " + name);
+        return;
+    }
+    if (!video.isOpened() && !video.open(dest, fourccFor(dest), rate, out.size()))
+        throw std::runtime_error("Cannot open video writer for " + dest);
+    video.write(out);
+}
@@ -0,0 +1,83 @@
+// ----------------- frame_stream.h -----------------
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "bounded_queue.h"
+#include "frame.h"
+
+// Streaming decode and encode stages. Each runs on its own thread behind a
+// bounded queue, so with a reader and a writer around a graph, frame N+1
+// decodes and frame N-1 encodes while frame N evaluates, and at most
+// `depth` frames wait on either side.
+
+// True for sources FrameReader treats as a stream rather than a still:
+// video files, printf-style sequences (frame_%04d.png), globs and directories.
+bool isStreamSource(const std::string& path);
+
+// Decodes a video file, printf-style sequence, glob or directory of images
+// ahead of the consumer. Frames keep the decoder's BGR order. Decode
+// buffers are recycled once nothing downstream references them, so memory
+// stays flat over a stream. Image files that fail to decode are skipped
+// and counted.
+class FrameReader {
+public:
+    explicit FrameReader(const std::string& source, size_t depth = 4);
+    ~FrameReader();
+
+    // Blocks until the next frame is decoded; false at end of stream.
+    bool next(Frame& frame);
+    double fps() const { return rate; }
+    int frameCount() const { return count; }   // -1 if unknown
+    int skipped() const { return skippedFiles; }
+
+private:
+    void run();
+    cv::Mat& acquire();
+
+    cv::VideoCapture cap;
+    std::vector<std::string> files;
+    double rate = 0;
+    int count = -1;
+    std::atomic<int> skippedFiles{0};
+    BoundedQueue<Frame> queue;
+    std::vector<cv::Mat> buffers;   // decode targets, reused when unshared
+    std::thread thread;
+};
+
+// Encodes frames to a video file (by extension) or a printf-style image
+// sequence, on its own thread, converting only frames not already in BGR
+// order. The writer opens on the first frame.
+class FrameWriter {
+public:
+    FrameWriter(const std::string& dest, double fps, size_t depth = 4);
+    ~FrameWriter();
+
+    // Blocks while `depth` frames are already waiting.
+    void write(const Frame& frame);
+    // Flushes and stops; throws if any frame failed to encode.
+    void close();
+    int framesWritten() const { return written; }
+
+private:
+    void run();
+    void encode(const Frame& frame);
+
+    std::string dest;
+    double rate;
+    bool sequence;
+    std::string before, after;  // a sequence's name around its index
+    int width = 0;              // the index's minimum width, padded with `pad`
+    char pad = ' ';
+    cv::VideoWriter video;
+    cv::Mat bgr;
+    BoundedQueue<Frame> queue;
+    std::atomic<int> written{0};
+    std::mutex m;
+    std::string error;
+    std::thread thread;
+};
@@ -0,0 +1,356 @@
+#include "graph_executor.h"
+#include "node_framework.h"
+#include "thread_pool.h"
+#include "profiler.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <unordered_set>
+#include <condition_variable>
+#include <mutex>
+
+namespace {
+
+struct RunState {
+    const ExecutionPlan* plan;
+    ThreadPool* pool;
+    std::unique_ptr<std::atomic<int>[]> waiting;
+    std::vector<char> live;    // dirty when the run started
+    std::unique_ptr<std::atomic<int>[]> unread;   // live readers yet to run, per producer
+    std::unique_ptr<std::atomic<bool>[]> blocked; // an upstream node failed or stayed dirty
+    bool release;
+    std::mutex m;
+    std::condition_variable done;
+    size_t remaining;
+    std::exception_ptr failure;
+    const std::function<bool()>* cancelled;
+    std::atomic<bool> stopped{false};
+    ResultCache* cache;
+    Profiler* profiler;
+    Frame::CopyCounter copies;   // made by this run's nodes, on any thread
+};
+
+// Runs a fused chain: one LUT pass over the chain's input when every member
+// has a table and the data is 8-bit, otherwise member by member.
+void runChain(const std::vector<Node*>& chain) {
+    Node* tail = chain.back();
+    if (!tail->isDirty()) return;
+    const Frame& in = chain.front()->inputData();
+    if (in.empty()) {
+        for (Node* n : chain) {
+            n->outputs[0].data = Frame();
+            n->markClean();
+        }
+        return;
+    }
+    ChannelOrder order = in.order();
+    if (in.mat().depth() == CV_8U) {
+        cv::Mat lut(1, 256, CV_8U), step;
+        for (int v = 0; v < 256; v++) lut.at<uchar>(0, v) = uchar(v);
+        bool ok = true;
+        for (Node* n : chain) {
+            if (!(ok = n->pointwiseLut(step))) break;
+            cv::LUT(lut, step, lut);
+        }
+        if (ok) {
+            // A table lookup can overwrite its source when no one else reads it.
+            Frame own = chain.front()->takeInput();
+            cv::Mat src = own.empty() ? in.mat() : own.writable();
+            cv::Mat out = own.empty() ? FramePool::mat() : src;
+            cv::LUT(src, lut, out);
+            for (Node* n : chain) {
+                n->outputs[0].data = n == tail ? Frame(out, order) : Frame();
+                n->markClean();
+            }
+            return;
+        }
+    }
+    // Intermediates may hold nothing from an earlier fused pass.
+    for (Node* n : chain) n->markDirty();
+    for (Node* n : chain) n->process();
+}
+
+// Serves a dirty node from the cache, or computes it and remembers the result.
+RunStatus runNode(RunState& st, int i) {
+    const ExecutionPlan& p = *st.plan;
+    Node* node = p.order[i];
+    if (!node->isDirty()) return RunStatus::Clean;
+    const auto& chain = p.fusedChain[i];
+    bool cacheable = st.cache && node->isCacheable();
+    Frame hit;
+    if (cacheable && st.cache->lookup(node->fingerprint, hit)) {
+        for (Node* n : chain) {
+            if (n == node) continue;
+            n->outputs[0].data = Frame();
+            n->markClean();
+        }
+        node->outputs[0].data = hit;
+        node->markClean();
+        return RunStatus::Cached;
+    }
+    if (!chain.empty()) runChain(chain);
+    else node->process();
+    if (cacheable && !node->isDirty()) st.cache->insert(node->fingerprint, node->outputs[0].data);
+    return RunStatus::Computed;
+}
+
+void record(RunState& st, Node* node, RunStatus status, double startUs) {
+    NodeSample s;
+    s.nodeId = node->id;
+    s.name = node->name;
+    s.status = status;
+    s.startUs = startUs;
+    s.durUs = st.profiler->now() - startUs;
+    if (status == RunStatus::Computed && !node->outputs.empty()) s.bytes = node->outputs[0].data.bytes();
+    st.profiler->record(std::move(s));
+}
+
+// True if node i is the only reader of its one input left in this pass, so
+// it may take that frame over; sources keep theirs.
+bool soleReader(const RunState& st, int i) {
+    const auto& reads = st.plan->reads[i];
+    return st.release && reads.size() == 1 && st.unread[reads[0]] == 1
+        && !st.plan->order[reads[0]]->inputs.empty();
+}
+
+// Called once node i is done with its inputs; producers with no readers left
+// give their frames back, unless a cache entry still holds the buffer.
+void releaseInputs(RunState& st, int i) {
+    for (int j : st.plan->reads[i]) {
+        Node* src = st.plan->order[j];
+        if (--st.unread[j] != 0 || !st.release || src->inputs.empty()) continue;
+        for (auto& port : src->outputs) port.data = Frame();
+    }
+}
+
+void execute(const std::shared_ptr<RunState>& st, int i) {
+    const ExecutionPlan& p = *st->plan;
+    Frame::CopyScope counting(&st->copies);
+    while (i >= 0) {
+        Node* node = p.order[i];
+        bool profiling = st->profiler && st->profiler->isEnabled();
+        double t0 = profiling ? st->profiler->now() : 0;
+        // A node left dirty leaves everything below it dirty too, so the
+        // next edit above it still reaches the outputs.
+        bool failed = st->blocked[i];
+        try {
+            if (!st->stopped && *st->cancelled && (*st->cancelled)()) st->stopped = true;
+            node->fingerprint = nodeFingerprint(*node);
+            RunStatus status;
+            if (st->stopped || failed) status = node->isDirty() ? RunStatus::Cancelled : RunStatus::Clean;
+            else if (p.deferred[i]) status = RunStatus::Fused;
+            else {
+                Node* reader = p.fusedChain[i].empty() ? node : p.fusedChain[i].front();
+                reader->lastReader = soleReader(*st, i);
+                status = runNode(*st, i);
+                reader->lastReader = false;
+                failed = node->isDirty();
+            }
+            if (status != RunStatus::Cancelled) releaseInputs(*st, i);
+            if (profiling) record(*st, node, status, t0);
+        } catch (...) {
+            failed = true;
+            std::lock_guard<std::mutex> lk(st->m);
+            if (!st->failure) st->failure = std::current_exception();
+        }
+        // Continue down the first ready successor on this thread and hand
+        // the other branches to the pool.
+        int next = -1;
+        for (int s : p.successors[i]) {
+            if (!st->live[s]) continue;
+            if (failed) st->blocked[s] = true;
+            if (--st->waiting[s] != 0) continue;
+            if (next < 0) next = s;
+            else st->pool->submit([st, s]{ execute(st, s); });
+        }
+        {
+            std::lock_guard<std::mutex> lk(st->m);
+            if (--st->remaining == 0) st->done.notify_all();
+        }
+        i = next;
+    }
+}
+
+// OpenCV's thread count: the one set by setThreadBudget(), or 0 to follow
+// the last compiled plan; and the count last handed to OpenCV.
+std::atomic<int> fixedThreads{0}, appliedThreads{0};
+
+void applyThreads(int threads) {
+    if (appliedThreads.exchange(threads) != threads) cv::setNumThreads(threads);
+}
+
+}
+
+GraphExecutor::GraphExecutor(ThreadPool& pool) : pool(pool) {}
+
+void GraphExecutor::setThreadBudget(int threads) {
+    fixedThreads = std::max(0, threads);
+    applyThreads(threads > 0 ? threads : int(ThreadPool::instance().size()));
+}
+
+void GraphExecutor::compile(const std::unordered_map<int, std::shared_ptr<Node>>& nodes) {
+    std::vector<Node*> all;
+    for (auto& kv : nodes) all.push_back(kv.second.get());
+    std::sort(all.begin(), all.end(), [](Node* a, Node* b){ return a->id < b->id; });
+
+    std::unordered_map<Node*, int> slot;
+    for (int i = 0; i < int(all.size()); i++) slot[all[i]] = i;
+
+    std::vector<std::vector<int>> succ(all.size());
+    std::vector<int> indeg(all.size(), 0);
+    for (int i = 0; i < int(all.size()); i++) {
+        for (auto& port : all[i]->outputs)
+            for (auto& c : port.connections) {
+                auto it = slot.find(c.node);
+                if (it == slot.end()) continue;
+                auto& s = succ[i];
+                if (std::find(s.begin(), s.end(), it->second) != s.end()) continue;
+                s.push_back(it->second);
+                indeg[it->second]++;
+            }
+    }
+
+    // Kahn's algorithm, seeded in id order so the plan is deterministic.
+    ExecutionPlan p;
+    std::vector<int> level(all.size(), 0), remaining = indeg, queue;
+    for (int i = 0; i < int(all.size()); i++) if (indeg[i] == 0) queue.push_back(i);
+    for (size_t head = 0; head < queue.size(); head++) {
+        int i = queue[head];
+        for (int s : succ[i]) {
+            level[s] = std::max(level[s], level[i] + 1);
+            if (--remaining[s] == 0) queue.push_back(s);
+        }
+    }
+    if (queue.size() != all.size()) throw std::runtime_error("Node graph contains a cycle");
+
+    std::vector<int> position(all.size());
+    for (int k = 0; k < int(queue.size()); k++) position[queue[k]] = k;
+    std::vector<int> perLevel(all.size() + 1, 0);
+    for (int i : queue) {
+        p.order.push_back(all[i]);
+        p.predecessorCount.push_back(indeg[i]);
+        std::vector<int> s;
+        for (int j : succ[i]) s.push_back(position[j]);
+        p.successors.push_back(std::move(s));
+        p.width = std::max(p.width, ++perLevel[level[i]]);
+    }
+
+    // Pointwise node i continues the run of its only upstream node when that
+    // node is pointwise too and feeds nothing else.
+    std::vector<int> runPrev(all.size(), -1);
+    for (int i : queue) {
+        Node* n = all[i];
+        if (!n->isPointwise() || n->inputs.size() != 1 || n->inputs[0].connections.size() != 1) continue;
+        auto it = slot.find(n->inputs[0].connections[0].node);
+        if (it == slot.end()) continue;
+        Node* up = all[it->second];
+        if (up->isPointwise() && up->outputs.size() == 1 && up->outputs[0].connections.size() == 1)
+            runPrev[i] = it->second;
+    }
+    std::vector<char> hasNext(all.size(), 0);
+    for (int i : queue) if (runPrev[i] >= 0) hasNext[runPrev[i]] = 1;
+    p.fusedChain.resize(all.size());
+    p.deferred.assign(all.size(), 0);
+    for (int i : queue) {
+        if (runPrev[i] < 0 || hasNext[i]) continue;
+        std::vector<Node*> chain;
+        for (int j = i; j >= 0; j = runPrev[j]) {
+            chain.insert(chain.begin(), all[j]);
+            if (j != i) p.deferred[position[j]] = 1;
+        }
+        p.fusedChain[position[i]] = std::move(chain);
+    }
+
+    // What each node reads when it runs: its producers, or for a fused run
+    // the producers of the run's first node. Deferred members read nothing.
+    p.reads.resize(all.size());
+    for (size_t k = 0; k < p.order.size(); k++) {
+        if (p.deferred[k]) continue;
+        Node* reader = p.fusedChain[k].empty() ? p.order[k] : p.fusedChain[k].front();
+        auto& r = p.reads[k];
+        for (auto& port : reader->inputs)
+            for (auto& c : port.connections) {
+                auto it = slot.find(c.node);
+                if (it == slot.end()) continue;
+                int j = position[it->second];
+                if (std::find(r.begin(), r.end(), j) == r.end()) r.push_back(j);
+            }
+    }
+
+    // Nodes that were deferred under the old plan may have no output; make
+    // sure they recompute if they now run on their own.
+    std::unordered_set<Node*> stillDeferred;
+    for (size_t k = 0; k < p.order.size(); k++) if (p.deferred[k]) stillDeferred.insert(p.order[k]);
+    for (size_t k = 0; k < current.order.size(); k++)
+        if (current.deferred[k] && !stillDeferred.count(current.order[k])) current.order[k]->markDirty();
+    current = std::move(p);
+
+    // Branches that can run at once share the pool's cores between their
+    // OpenCV loops, so those don't multiply into pool.size() threads each.
+    // Changed only here, when the structure changes, never per run.
+    if (fixedThreads == 0) applyThreads(std::max(1, int(pool.size()) / current.width));
+}
+
+bool GraphExecutor::run(const std::function<bool()>& cancelled) {
+    size_t n = current.order.size();
+    if (n == 0) return true;
+
+    // A dirty node reading a producer whose frame was released last pass
+    // needs it recomputed (or served from the cache). The producer is only
+    // touched: its other readers are up to date and must not rerun. Reverse
+    // topological order reaches every producer after all of its readers.
+    for (size_t k = n; k-- > 0; ) {
+        if (!current.order[k]->isDirty()) continue;
+        for (int j : current.reads[k]) {
+            Node* src = current.order[j];
+            if (!src->isDirty() && !src->outputs.empty() && src->outputs[0].data.empty()) src->touch();
+        }
+    }
+
+    // Only the dirty part of the graph is scheduled. Bar touched producers
+    // it is closed under successors; each node just waits for its dirty
+    // predecessors and clean nodes cost nothing beyond this scan.
+    auto st = std::make_shared<RunState>();
+    st->plan = &current;
+    st->pool = &pool;
+    st->cancelled = &cancelled;
+    st->cache = cache;
+    st->profiler = profiler;
+    st->release = release;
+    st->live.resize(n);
+    st->waiting.reset(new std::atomic<int>[n]);
+    st->unread.reset(new std::atomic<int>[n]);
+    st->blocked.reset(new std::atomic<bool>[n]);
+    for (size_t i = 0; i < n; i++) {
+        st->waiting[i] = st->unread[i] = 0;
+        st->blocked[i] = false;
+    }
+    size_t live = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!(st->live[i] = current.order[i]->isDirty())) continue;
+        live++;
+        for (int s : current.successors[i]) st->waiting[s]++;
+        for (int j : current.reads[i]) st->unread[j]++;
+    }
+    st->remaining = live;
+
+    if (profiler) profiler->beginEvaluation();
+
+    for (size_t i = 0; i < n; i++)
+        if (st->live[i] && st->waiting[i] == 0) pool.submit([st, i]{ execute(st, int(i)); });
+
+    // Help drain the pool while waiting, so running from a worker can't deadlock.
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(st->m);
+            if (st->remaining == 0) break;
+        }
+        if (pool.tryRunOne()) continue;
+        std::unique_lock<std::mutex> lk(st->m);
+        st->done.wait_for(lk, std::chrono::milliseconds(1), [&]{ return st->remaining == 0; });
+    }
+
+    if (profiler) profiler->endEvaluation(!st->stopped && !st->failure, st->copies.copies, st->copies.bytesCopied);
+    if (st->failure) std::rethrow_exception(st->failure);
+    return !st->stopped;
+}
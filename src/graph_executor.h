@@ -0,0 +1,62 @@
+// ----------------- graph_executor.h -----------------
+#pragma once
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class Node;
+class Profiler;
+class ResultCache;
+class ThreadPool;
+
+// Topological schedule of a graph, rebuilt only when its structure changes.
+struct ExecutionPlan {
+    std::vector<Node*> order;                 // topological order
+    std::vector<std::vector<int>> successors; // indices into order
+    std::vector<int> predecessorCount;
+    int width = 1;                            // widest level, i.e. max parallel branches
+    // Runs of single-consumer pointwise nodes. The last node of a run does
+    // the whole run as one composed LUT pass; the others are deferred to it.
+    std::vector<std::vector<Node*>> fusedChain; // per node: run ending here, if any
+    std::vector<char> deferred;
+    // Producers each node reads when it runs; drives buffer liveness.
+    std::vector<std::vector<int>> reads;
+};
+
+class GraphExecutor {
+public:
+    explicit GraphExecutor(ThreadPool& pool);
+
+    void compile(const std::unordered_map<int, std::shared_ptr<Node>>& nodes);
+    // Processes every dirty node once its dirty inputs are ready; clean
+    // nodes are not visited. Independent branches run concurrently.
+    // Rethrows the first node failure; whatever is below a failed node
+    // stays dirty. Once cancelled() turns true no further node is started
+    // and the remaining ones stay dirty; returns false in that case.
+    bool run(const std::function<bool()>& cancelled = {});
+
+    const ExecutionPlan& plan() const { return current; }
+    // OpenCV's parallel loops belong to the whole process. By default each
+    // compile() gives them the pool divided by the plan's width, so parallel
+    // branches don't each spawn a full set of threads; a chain gets the whole
+    // pool, and a wide graph keeps its small share even when only one
+    // branch is dirty. With several graphs the last compiled wins. A tool
+    // running N graphs at once fixes the count here instead; 0 goes back to
+    // following the plan.
+    static void setThreadBudget(int threads);
+    // Dirty nodes whose fingerprint is cached are served from it.
+    void setCache(ResultCache* c) { cache = c; }
+    // Receives a sample for every node each run visits.
+    void setProfiler(Profiler* p) { profiler = p; }
+    // Drop intermediate frames once their last reader in a pass has run,
+    // and let a sole reader overwrite its input in place.
+    void setReleaseIntermediates(bool on) { release = on; }
+
+private:
+    ThreadPool& pool;
+    ResultCache* cache = nullptr;
+    Profiler* profiler = nullptr;
+    bool release = true;
+    ExecutionPlan current;
+};
@@ -0,0 +1,111 @@
+#include "graph_io.h"
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+
+namespace {
+
+std::map<std::string, std::function<std::shared_ptr<Node>()>>& registry() {
+    static std::map<std::string, std::function<std::shared_ptr<Node>()>> types = {
+        {"Input",              []{ return std::make_shared<InputNode>(); }},
+        {"Output",             []{ return std::make_shared<OutputNode>(); }},
+        {"BrightnessContrast", []{ return std::make_shared<BrightnessContrastNode>(); }},
+        {"Blur",               []{ return std::make_shared<BlurNode>(); }},
+    };
+    return types;
+}
+
+}
+
+std::shared_ptr<Node> createNode(const std::string& type) {
+    auto it = registry().find(type);
+    return it == registry().end() ? nullptr : it->second();
+}
+
+void registerNodeType(const std::string& type, std::function<std::shared_ptr<Node>()> make) {
+    registry()[type] = std::move(make);
+}
+
+namespace {
+
+void writeGraph(cv::FileStorage& fs, const NodeGraph& graph) {
+    std::vector<Node*> sorted;
+    for (auto& kv : graph.nodes) sorted.push_back(kv.second.get());
+    std::sort(sorted.begin(), sorted.end(), [](Node* a, Node* b){ return a->id < b->id; });
+
+    fs << "version" << 1;
+    fs << "nodes" << "[";
+    for (Node* n : sorted) {
+        fs << "{" << "id" << n->id << "type" << n->typeName();
+        if (auto* in = dynamic_cast<InputNode*>(n))
+            if (!in->path().empty()) fs << "path" << in->path();
+        fs << "params" << "{";
+        for (auto& p : n->paramNames()) fs << p << n->getParam(p);
+        fs << "}" << "}";
+    }
+    fs << "]";
+
+    std::set<std::tuple<int,int,int,int>> edges;
+    for (Node* n : sorted)
+        for (int o = 0; o < int(n->outputs.size()); o++)
+            for (auto& c : n->outputs[o].connections)
+                if (graph.nodes.count(c.node->id)) edges.insert({n->id, o, c.node->id, c.portIndex});
+    fs << "edges" << "[";
+    for (auto& [from, out, to, in] : edges)
+        fs << "{" << "from" << from << "output" << out << "to" << to << "input" << in << "}";
+    fs << "]";
+}
+
+// `what` names the source in errors.
+void readGraph(NodeGraph& graph, cv::FileStorage& fs, const std::string& what, bool skipImages) {
+    std::map<int, std::shared_ptr<Node>> byFileId;
+    for (const auto& fn : fs["nodes"]) {
+        std::string type = fn["type"].string();
+        auto n = createNode(type);
+        if (!n) throw std::runtime_error("Unknown node type '" + type + "' in " + what);
+        cv::FileNode params = fn["params"];
+        for (auto& p : n->paramNames())
+            if (!params[p].empty()) n->setParam(p, params[p].real());
+        std::string src = fn["path"].empty() ? std::string() : fn["path"].string();
+        if (!src.empty())
+            if (auto in = std::dynamic_pointer_cast<InputNode>(n)) {
+                if (skipImages) in->setImage(Frame(), src);
+                else in->loadImage(src);
+            }
+        byFileId[int(fn["id"])] = n;
+        graph.addNode(n);
+    }
+    for (const auto& e : fs["edges"]) {
+        auto from = byFileId.find(int(e["from"])), to = byFileId.find(int(e["to"]));
+        if (from == byFileId.end() || to == byFileId.end())
+            throw std::runtime_error("Edge refers to a missing node in " + what);
+        graph.connectNodes(from->second->id, to->second->id, int(e["output"]), int(e["input"]));
+    }
+}
+
+}
+
+void saveGraph(const NodeGraph& graph, const std::string& path) {
+    cv::FileStorage fs(path, cv::FileStorage::WRITE);
+    if (!fs.isOpened()) throw std::runtime_error("Cannot write graph file " + path);
+    writeGraph(fs, graph);
+}
+
+void loadGraph(NodeGraph& graph, const std::string& path, bool skipImages) {
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if (!fs.isOpened()) throw std::runtime_error("Cannot read graph file " + path);
+    readGraph(graph, fs, path, skipImages);
+}
+
+std::string graphToString(const NodeGraph& graph) {
+    cv::FileStorage fs(".json", cv::FileStorage::WRITE | cv::FileStorage::MEMORY);
+    writeGraph(fs, graph);
+    return fs.releaseAndGetString();
+}
+
+void loadGraphFromString(NodeGraph& graph, const std::string& text, bool skipImages) {
+    cv::FileStorage fs(text, cv::FileStorage::READ | cv::FileStorage::MEMORY);
+    if (!fs.isOpened()) throw std::runtime_error("Cannot parse graph text");
+    readGraph(graph, fs, "graph text", skipImages);
+}
@@ -0,0 +1,34 @@
+// ----------------- graph_io.h -----------------
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include "node_framework.h"
+
+// Graph files are written through cv::FileStorage, so the extension picks
+// the format (.json, .yml or .xml). They hold each node's type, named
+// parameters and input path, plus every connection.
+
+// Creates a node from its typeName(); nullptr for unknown types.
+std::shared_ptr<Node> createNode(const std::string& type);
+// Lets other modules make their node types loadable.
+void registerNodeType(const std::string& type, std::function<std::shared_ptr<Node>()> make);
+
+void saveGraph(const NodeGraph& graph, const std::string& path);
+// Adds the file's nodes and edges to `graph` (ids are reassigned). Input
+// nodes with a stored path load their image, and video inputs open their
+// stream, unless skipImages is set; then inputs only remember the path.
+void loadGraph(NodeGraph& graph, const std::string& path, bool skipImages = false);
+// The same as JSON text in memory, e.g. to hand a graph to another process.
+std::string graphToString(const NodeGraph& graph);
+void loadGraphFromString(NodeGraph& graph, const std::string& text, bool skipImages = false);
+
+// First node of the given type in id order, or nullptr.
+template<typename T>
+std::shared_ptr<T> findNode(const NodeGraph& graph) {
+    std::shared_ptr<T> best;
+    for (auto& kv : graph.nodes)
+        if (auto n = std::dynamic_pointer_cast<T>(kv.second))
+            if (!best || n->id < best->id) best = n;
+    return best;
+}
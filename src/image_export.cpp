@@ -0,0 +1,182 @@
+#include "image_export.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "tiled_image.h"
+#ifdef NODE_HAVE_TIFF
+#include <tiffio.h>
+#endif
+#ifdef NODE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+std::string lowerExtension(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return char(std::tolower(c)); });
+    return ext;
+}
+
+#ifdef NODE_HAVE_TIFF
+// One edge-padded tile in TIFF's RGB order, deflated when zlib is at hand.
+std::vector<uchar> packTile(const Frame& image, const cv::Rect& r, int ts) {
+    const cv::Mat& img = image.mat();
+    cv::Mat tile(ts, ts, img.type(), cv::Scalar::all(0));
+    cv::Mat inner = tile(cv::Rect(0, 0, r.width, r.height));
+    img(r).copyTo(inner);
+    if (image.order() == ChannelOrder::BGR && tile.channels() >= 3)
+        cv::cvtColor(tile, tile, tile.channels() == 4 ? cv::COLOR_BGRA2RGBA : cv::COLOR_BGR2RGB);
+    size_t bytes = tile.total() * tile.elemSize();
+#ifdef NODE_HAVE_ZLIB
+    uLongf n = compressBound(uLong(bytes));
+    std::vector<uchar> out(n);
+    if (compress2(out.data(), &n, tile.data, uLong(bytes), Z_DEFAULT_COMPRESSION) != Z_OK)
+        throw std::runtime_error("Failed to compress TIFF tile");
+    out.resize(n);
+    return out;
+#else
+    return std::vector<uchar>(tile.data, tile.data + bytes);
+#endif
+}
+
+// Tiled TIFF that TiledImage reads back a tile at a time. libtiff's handle
+// is single-threaded, so tiles are compressed here, a row in parallel, and
+// handed to it raw; without zlib libtiff compresses them one by one.
+void writeTiledTiff(const std::string& path, const Frame& image, const ExportOptions& o,
+                    const ExportProgress& progress) {
+    const cv::Mat& img = image.mat();
+    int cn = img.channels(), depth = img.depth();
+    int ts = std::max(16, o.tileSize / 16 * 16);   // TIFF tiles are multiples of 16
+    bool big = img.total() * img.elemSize() > (size_t(3) << 30);
+    std::unique_ptr<TIFF, void(*)(TIFF*)> tif(TIFFOpen(path.c_str(), big ? "w8" : "w"), TIFFClose);
+    if (!tif) throw std::runtime_error("Cannot write " + path);
+    TIFF* t = tif.get();
+    TIFFSetField(t, TIFFTAG_IMAGEWIDTH, uint32_t(img.cols));
+    TIFFSetField(t, TIFFTAG_IMAGELENGTH, uint32_t(img.rows));
+    TIFFSetField(t, TIFFTAG_BITSPERSAMPLE, uint16_t(depth == CV_8U ? 8 : depth == CV_16U ? 16 : 32));
+    TIFFSetField(t, TIFFTAG_SAMPLEFORMAT, uint16_t(depth == CV_32F ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT));
+    TIFFSetField(t, TIFFTAG_SAMPLESPERPIXEL, uint16_t(cn));
+    TIFFSetField(t, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(t, TIFFTAG_PHOTOMETRIC, cn >= 3 ? PHOTOMETRIC_RGB : PHOTOMETRIC_MINISBLACK);
+    if (cn == 2 || cn == 4) {
+        uint16_t extra = EXTRASAMPLE_UNASSALPHA;
+        TIFFSetField(t, TIFFTAG_EXTRASAMPLES, 1, &extra);
+    }
+    TIFFSetField(t, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+    TIFFSetField(t, TIFFTAG_TILEWIDTH, uint32_t(ts));
+    TIFFSetField(t, TIFFTAG_TILELENGTH, uint32_t(ts));
+
+    int across = (img.cols + ts - 1) / ts, down = (img.rows + ts - 1) / ts;
+    std::vector<std::vector<uchar>> row(across);
+    for (int ty = 0; ty < down; ty++) {
+        cv::parallel_for_(cv::Range(0, across), [&](const cv::Range& range){
+            for (int tx = range.start; tx < range.end; tx++)
+                row[tx] = packTile(image, cv::Rect(tx * ts, ty * ts, ts, ts) & cv::Rect(0, 0, img.cols, img.rows), ts);
+        });
+        for (int tx = 0; tx < across; tx++) {
+            ttile_t index = TIFFComputeTile(t, uint32_t(tx * ts), uint32_t(ty * ts), 0, 0);
+#ifdef NODE_HAVE_ZLIB
+            tmsize_t n = TIFFWriteRawTile(t, index, row[tx].data(), tmsize_t(row[tx].size()));
+#else
+            tmsize_t n = TIFFWriteEncodedTile(t, index, row[tx].data(), tmsize_t(row[tx].size()));
+#endif
+            if (n < 0) throw std::runtime_error("Failed writing " + path);
+        }
+        if (progress) progress(double(ty + 1) / down);
+    }
+    if (!TIFFWriteDirectory(t)) throw std::runtime_error("Failed writing " + path);
+}
+#endif
+
+}
+
+void exportImage(const std::string& path, const Frame& image, const ExportOptions& options,
+                 const ExportProgress& progress) {
+    if (image.empty()) throw std::runtime_error("Nothing to write to " + path);
+    std::string ext = lowerExtension(path);
+    if (ext == ".ntf") {
+        writeTiledImage(path, image.mat(), image.order(), options.tileSize, progress);
+        return;
+    }
+#ifdef NODE_HAVE_TIFF
+    int depth = image.mat().depth();
+    if ((ext == ".tif" || ext == ".tiff") && options.tiffTiled
+        && (depth == CV_8U || depth == CV_16U || depth == CV_32F)) {
+        writeTiledTiff(path, image, options, progress);
+        return;
+    }
+#endif
+    std::vector<int> params;
+    if (ext == ".png")
+        params = {cv::IMWRITE_PNG_COMPRESSION, std::clamp(options.pngCompression, 0, 9)};
+    else if (ext == ".jpg" || ext == ".jpeg")
+        params = {cv::IMWRITE_JPEG_QUALITY, std::clamp(options.jpegQuality, 0, 100)};
+    if (progress) progress(0);
+    if (!cv::imwrite(path, toBgr(image.mat(), image.order()), params))
+        throw std::runtime_error("Failed to write " + path);
+    if (progress) progress(1);
+}
+
+// Joined outside the lock: a callback still running may call running().
+ExportQueue::~ExportQueue() {
+    std::list<Job> pending;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        pending.splice(pending.end(), jobs);
+    }
+    for (auto& j : pending) j.thread.join();
+}
+
+void ExportQueue::start(const std::string& path, const Frame& image, const ExportOptions& options,
+                        ExportProgress progress, Done done) {
+    launch(path, [image](const ExportProgress&){ return image; }, 0, options,
+           std::move(progress), std::move(done));
+}
+
+void ExportQueue::start(const std::string& path, Render render, const ExportOptions& options,
+                        ExportProgress progress, Done done) {
+    launch(path, std::move(render), 0.5, options, std::move(progress), std::move(done));
+}
+
+void ExportQueue::launch(const std::string& path, Render render, double renderShare,
+                         const ExportOptions& options, ExportProgress progress, Done done) {
+    std::lock_guard<std::mutex> lk(m);
+    reap();
+    Job& job = jobs.emplace_back();
+    job.thread = std::thread([=, &job]{
+        std::string error;
+        try {
+            ExportProgress part[2];
+            if (progress) {
+                part[0] = [&](double f){ progress(f * renderShare); };
+                part[1] = [&](double f){ progress(renderShare + f * (1 - renderShare)); };
+            }
+            exportImage(path, render(part[0]), options, part[1]);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (done) done(error);
+        job.finished = true;
+    });
+}
+
+int ExportQueue::running() const {
+    std::lock_guard<std::mutex> lk(m);
+    return int(std::count_if(jobs.begin(), jobs.end(), [](const Job& j){ return !j.finished; }));
+}
+
+// Joins exports that have finished; the caller holds the lock.
+void ExportQueue::reap() {
+    for (auto it = jobs.begin(); it != jobs.end();) {
+        if (it->finished) {
+            it->thread.join();
+            it = jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+// ----------------- image_export.h -----------------
+#pragma once
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "frame.h"
+
+struct ExportOptions {
+    int pngCompression = 3;   // 0 (fastest) to 9 (smallest)
+    int jpegQuality = 95;     // 0 to 100
+    bool tiffTiled = true;    // tiled, deflated TIFF when built with libtiff; strips otherwise
+    int tileSize = 256;       // TIFF and .ntf tiles
+};
+
+// Fraction done, in [0,1]. May be called from any thread.
+using ExportProgress = std::function<void(double)>;
+
+// Encodes `image` to `path`, choosing the encoder by extension and resolving
+// the channel order on the way out. Tiled formats (.ntf, tiled TIFF) prepare
+// and compress a row of tiles in parallel; PNG and JPEG are single streams
+// and report only their start and end. Throws on failure.
+void exportImage(const std::string& path, const Frame& image, const ExportOptions& options = {},
+                 const ExportProgress& progress = {});
+
+// Runs each export on a thread of its own, so several files encode at once
+// and neither the caller nor the evaluation pool waits on an encoder. The
+// frame is held by reference until its file is written.
+class ExportQueue {
+public:
+    using Done = std::function<void(const std::string& error)>;   // empty on success
+    // Produces the frame on the export's thread, reporting its own progress.
+    using Render = std::function<Frame(const ExportProgress&)>;
+
+    ExportQueue() = default;
+    ExportQueue(const ExportQueue&) = delete;
+    ExportQueue& operator=(const ExportQueue&) = delete;
+    // Waits for exports still running.
+    ~ExportQueue();
+
+    // Safe to call from any thread; `progress` and `done` run on the export's.
+    void start(const std::string& path, const Frame& image, const ExportOptions& options,
+               ExportProgress progress = {}, Done done = {});
+    // Renders first, then encodes; `progress` covers both, half each. A
+    // throwing render fails the export like an encoder would.
+    void start(const std::string& path, Render render, const ExportOptions& options,
+               ExportProgress progress = {}, Done done = {});
+    int running() const;
+
+private:
+    struct Job {
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+    void launch(const std::string& path, Render render, double renderShare,
+                const ExportOptions& options, ExportProgress progress, Done done);
+    void reap();
+
+    mutable std::mutex m;
+    std::list<Job> jobs;
+};
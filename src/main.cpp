@@ -1,11 +1,21 @@
 #include "mainwindow.h"
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[]) {
     QApplication app(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption stress("stress",
+        "Fill the editor with <nodes> generated nodes, print the frame rate while panning, zooming and dragging, then exit.",
+        "nodes");
+    parser.addOption(stress);
+    parser.process(app);
+
     MainWindow mainWindow;
     mainWindow.show();
+    if (parser.isSet(stress)) mainWindow.runStressTest(parser.value(stress).toInt(), true);
 
     return app.exec();
 }
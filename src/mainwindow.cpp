@@ -1,11 +1,74 @@
 // ----------------- mainwindow.cpp -----------------
 #include "mainwindow.h"
+#include "thread_pool.h"
+#include "tiled_renderer.h"
+#include "graph_io.h"
+#include "process_pool.h"
+
+// --- EditorScene ---
+EditorScene::EditorScene(QObject* p):QGraphicsScene(p){
+    setItemIndexMethod(BspTreeIndex);
+}
+
+void EditorScene::queueEdges(const std::vector<EdgeItem*>& edges){
+    for(auto* e:edges) pendingEdges.insert(e);
+    if(flushQueued||pendingEdges.isEmpty()) return;
+    flushQueued=true;
+    QMetaObject::invokeMethod(this,[this]{ flushEdges(); },Qt::QueuedConnection);
+}
+
+void EditorScene::forgetEdge(EdgeItem* e){ pendingEdges.remove(e); }
+
+void EditorScene::flushEdges(){
+    flushQueued=false;
+    for(auto* e:pendingEdges) e->updatePath();
+    pendingEdges.clear();
+}
+
+PortItem* EditorScene::portAt(const QPointF& pos) const {
+    QRectF probe(pos-QPointF(4,4),QSizeF(8,8));
+    for(auto* it:items(probe,Qt::IntersectsItemBoundingRect,Qt::DescendingOrder))
+        if(auto* port=qgraphicsitem_cast<PortItem*>(it)) return port;
+    return nullptr;
+}
+
+void EditorScene::connectPorts(EdgeItem* edge,PortItem* to){
+    // An input takes one source, as in the graph itself.
+    for(auto* e:std::vector<EdgeItem*>(to->parentNode->edges))
+        if(e!=edge&&e->toPort==to) delete e;
+    edge->setTarget(to);
+    if(onConnect) onConnect(edge->fromPort->parentNode->backendNode,to->parentNode->backendNode);
+}
+
+// --- EditorView ---
+EditorView::EditorView(QGraphicsScene* s):QGraphicsView(s){
+    setDragMode(ScrollHandDrag);
+    setTransformationAnchor(AnchorUnderMouse);
+    setViewportUpdateMode(SmartViewportUpdate);
+    setOptimizationFlags(DontSavePainterState|DontAdjustForAntialiasing);
+}
+
+void EditorView::wheelEvent(QWheelEvent* e){
+    qreal f=std::pow(1.2,e->angleDelta().y()/120.0);
+    qreal z=transform().m11()*f;
+    if(z<0.02||z>4) return;
+    scale(f,f);
+}
+
+void EditorView::paintEvent(QPaintEvent* e){
+    QGraphicsView::paintEvent(e);
+    frames++;
+}
 
 // --- NodeItem ---
+bool NodeItem::showProfile=false;
+
 NodeItem::NodeItem(Node* backend, QColor c)
   : backendNode(backend), color(c)
 {
-    setFlags(ItemIsMovable|ItemSendsGeometryChanges);
+    setFlags(ItemIsMovable|ItemIsSelectable|ItemSendsGeometryChanges);
+    // Text and rounded corners are rasterised once per zoom level, not per frame.
+    setCacheMode(DeviceCoordinateCache);
     if(!backend->inputs.empty()){
         auto* p=new PortItem(PortItem::In,this,0);
         inputs.push_back(p); p->setParentItem(this);
@@ -20,44 +83,89 @@ NodeItem::NodeItem(Node* backend, QColor c)
 
 QRectF NodeItem::boundingRect() const { return {0,0,qreal(w),qreal(h)}; }
 
-void NodeItem::paint(QPainter* p,const QStyleOptionGraphicsItem*,QWidget*){
+void NodeItem::paint(QPainter* p,const QStyleOptionGraphicsItem* opt,QWidget*){
+    // Zoomed out: a flat box is all that can be seen anyway.
+    if(opt->levelOfDetailFromTransform(p->worldTransform())<kDetailLod){
+        p->fillRect(boundingRect(),color);
+        return;
+    }
+    p->setPen(isSelected()?QPen(Qt::yellow,2):QPen(Qt::black));
     p->setBrush(color);
     p->drawRoundedRect(0,0,w,h,5,5);
     p->setPen(Qt::white);
     p->drawText(10,20,QString::fromStdString(backendNode->name));
+    if(!showProfile||lastMs<0) return;
+    // Green for cheap through red for the graph's slowest node.
+    QColor hot=QColor::fromHsvF((1.0-heat)/3.0,0.9,0.9);
+    p->setPen(Qt::NoPen); p->setBrush(hot);
+    p->drawRoundedRect(QRectF(0,h-22,w,22),5,5);
+    p->setPen(Qt::black);
+    p->drawText(QRectF(8,h-22,w-16,22),Qt::AlignVCenter|Qt::AlignLeft,
+                QString("%1 ms").arg(lastMs,0,'f',lastMs<10?2:1));
+    p->drawText(QRectF(8,h-22,w-16,22),Qt::AlignVCenter|Qt::AlignRight,toString(lastStatus));
+}
+
+void NodeItem::setProfile(double ms,RunStatus status,double h){
+    lastMs=ms; lastStatus=status; heat=std::clamp(h,0.0,1.0);
+    update();
+}
+
+QVariant NodeItem::itemChange(GraphicsItemChange change,const QVariant& value){
+    if(change==ItemPositionHasChanged&&!edges.empty())
+        if(auto* s=qobject_cast<EditorScene*>(scene())) s->queueEdges(edges);
+    return QGraphicsItem::itemChange(change,value);
 }
 
 // --- EdgeItem ---
 EdgeItem::EdgeItem(PortItem* from) : fromPort(from) {
     setPen(QPen(Qt::white,2)); setZValue(-1);
-    QPointF c=from->scenePos()+QPointF(5,5);
-    updatePath(c);
+    from->parentNode->edges.push_back(this);
+    updatePath(from->anchor());
+}
+
+EdgeItem::~EdgeItem(){
+    for(auto* port:{fromPort,toPort}){
+        if(!port) continue;
+        auto& v=port->parentNode->edges;
+        v.erase(std::remove(v.begin(),v.end(),this),v.end());
+    }
+    if(auto* s=qobject_cast<EditorScene*>(scene())) s->forgetEdge(this);
 }
 
 void EdgeItem::setTarget(PortItem* to){
     toPort=to;
-    updatePath(to->scenePos()+QPointF(5,5));
+    to->parentNode->edges.push_back(this);
+    updatePath();
 }
 
 void EdgeItem::updatePath(const QPointF& to){
-    QPointF f=fromPort->scenePos()+QPointF(5,5);
-    QPainterPath path(f);
+    QPainterPath path(fromPort->anchor());
     path.lineTo(to);
     setPath(path);
 }
 
+void EdgeItem::updatePath(){
+    if(toPort) updatePath(toPort->anchor());
+}
+
 // --- PortItem ---
 PortItem::PortItem(PortType t,NodeItem* pn,int idx)
   : QGraphicsEllipseItem(), type(t), parentNode(pn), portIndex(idx)
 {
     setBrush(type==Out?Qt::darkGreen:Qt::darkRed);
-    setFlag(ItemSendsScenePositionChanges);
+}
+
+void PortItem::paint(QPainter* p,const QStyleOptionGraphicsItem* opt,QWidget* w){
+    if(opt->levelOfDetailFromTransform(p->worldTransform())<kDetailLod) return;
+    QGraphicsEllipseItem::paint(p,opt,w);
 }
 
 void PortItem::mousePressEvent(QGraphicsSceneMouseEvent* e){
     if(type==Out){
         tempEdge=new EdgeItem(this);
         scene()->addItem(tempEdge);
+        e->accept();   // keep the drag here instead of moving the node
+        return;
     }
     QGraphicsEllipseItem::mousePressEvent(e);
 }
@@ -69,102 +177,315 @@ void PortItem::mouseMoveEvent(QGraphicsSceneMouseEvent* e){
 
 void PortItem::mouseReleaseEvent(QGraphicsSceneMouseEvent* e) {
     if (tempEdge) {
-        auto items = scene()->items(e->scenePos());
-        for (auto* it : items) {
-            if (auto* inP = qgraphicsitem_cast<PortItem*>(it)) {
-                if (inP->type == In) {
-                    Node* srcNode = parentNode->backendNode;
-                    Node* dstNode = inP->parentNode->backendNode;
-
-                    // find the MainWindow from the view
-                    auto views = parentNode->scene()->views();
-                    if (!views.isEmpty()) {
-                        if (auto* mw = qobject_cast<MainWindow*>(views.first()->window())) {
-                            mw->graph.connectNodes(srcNode->id, dstNode->id);
-                            mw->graph.propagateFrom(srcNode);
-                            mw->processGraph();
-                        }
-                    }
-
-                    tempEdge->setTarget(inP);
-                    break;
-                }
-            }
-        }
-        if (!tempEdge->toPort) {
-            scene()->removeItem(tempEdge);
-            delete tempEdge;
-        }
+        auto* s = static_cast<EditorScene*>(scene());
+        PortItem* inP = s->portAt(e->scenePos());
+        if (inP && inP->type == In && inP->parentNode != parentNode) s->connectPorts(tempEdge, inP);
+        else delete tempEdge;
         tempEdge = nullptr;
     }
     QGraphicsEllipseItem::mouseReleaseEvent(e);
 }
 // --- MainWindow ---
 MainWindow::MainWindow(QWidget* p):QMainWindow(p){
+    // Keep every node's output so a slider only reruns its own node.
+    graph.setReleaseIntermediates(false);
+    worker=std::make_unique<EvalWorker>(graph);
+    connect(worker.get(),&EvalWorker::resultReady,this,&MainWindow::showResult,Qt::QueuedConnection);
+    connect(worker.get(),&EvalWorker::detailReady,this,&MainWindow::showDetail,Qt::QueuedConnection);
+    connect(worker.get(),&EvalWorker::failed,this,[this](const QString& msg){
+        QMessageBox::critical(this,"Error",msg);
+    },Qt::QueuedConnection);
     setupUI(); setupMenu();
 }
 
+MainWindow::~MainWindow(){
+    for(auto& l:loaders){ l.cancelled=true; l.thread.join(); }
+}
+
+void MainWindow::openImage(const QString& f){
+    openTimer.start();
+    std::string path=f.toStdString();
+    auto in=std::make_shared<InputNode>();
+    // A large JPEG is first decoded at about the preview's scale, a fraction
+    // of the work of a full decode. The full image follows from a background
+    // thread and the graph re-evaluates when it lands.
+    QSize full=QImageReader(f).size();
+    QSize vs=preview->size()*preview->devicePixelRatioF();
+    int factor=full.isValid()&&!(fullQualityAct&&fullQualityAct->isChecked())
+        ? int(1/InputNode::proxyScaleFor({full.width(),full.height()},{vs.width(),vs.height()})) : 1;
+    bool progressive=false;
+    try{
+        progressive=in->loadPreview(path,factor,{full.width(),full.height()});
+        if(!progressive) in->loadImage(path);
+    }catch(const std::exception& e){ QMessageBox::critical(this,"Error",e.what()); return; }
+    inputNodePtr=in;
+    sourceSize=in->imageSize();
+    detailRegion=cv::Rect();
+    auto* ni=new NodeItem(in.get(),Qt::darkGreen);
+    scene->addItem(ni);
+    loadReport.clear();
+    previewFactor=progressive?std::min(factor,8):1;
+    firstPixelGen=editGraph([this,in,out=outputNodePtr]{
+        worker->setDetail({});
+        graph.addNode(in);
+        if(out) graph.connectNodes(in->id,out->id);
+    });
+    fullPixelGen=progressive?0:firstPixelGen;
+    updateRenderScale();
+    if(!deferredExports.empty()){
+        deferredExports.clear();
+        statusBar()->showMessage("Export cancelled: another image was opened",5000);
+    }
+    for(auto it=loaders.begin();it!=loaders.end();){
+        it->cancelled=true;
+        if(it->finished){ it->thread.join(); it=loaders.erase(it); }
+        else ++it;
+    }
+    decoding=progressive;
+    if(!progressive) return;
+
+    Loader& job=loaders.emplace_back();
+    job.thread=std::thread([this,in,path,&job]{
+        try{
+            Frame img=InputNode::decode(path);
+            if(!job.cancelled) QMetaObject::invokeMethod(this,[this,in,img,path]{
+                if(in!=inputNodePtr) return;
+                fullPixelGen=editGraph([in,img,path]{ in->setImage(img,path); });
+                sourceSize=img.size();   // the header's size can miss EXIF rotation
+                updateRenderScale();
+                // Queued after setImage(), so these render the full pixels.
+                decoding=false;
+                for(auto& e:std::exchange(deferredExports,{})) exportOutputs(e.first,e.second);
+            },Qt::QueuedConnection);
+        }catch(const std::exception& e){
+            if(!job.cancelled) QMetaObject::invokeMethod(this,[this,in,msg=QString(e.what())]{
+                if(in!=inputNodePtr) return;
+                decoding=false; deferredExports.clear();
+                QMessageBox::critical(this,"Error",msg);
+            },Qt::QueuedConnection);
+        }
+        job.finished=true;
+    });
+}
+
 void MainWindow::setupUI(){
     auto* sp=new QSplitter(this);
-    scene=new QGraphicsScene(this);
-    sp->addWidget(new QGraphicsView(scene));
-    previewLabel=new QLabel(); previewLabel->setMinimumSize(400,300);
-    sp->addWidget(previewLabel);
+    scene=new EditorScene(this);
+    scene->onConnect=[this](Node* from,Node* to){
+        int s=from->id,d=to->id;
+        editGraph([this,s,d]{ graph.connectNodes(s,d); });
+    };
+    view=new EditorView(scene);
+    sp->addWidget(view);
+    preview=new PreviewView();
+    connect(preview,&PreviewView::viewChanged,this,&MainWindow::updateRenderScale);
+    sp->addWidget(preview);
     setCentralWidget(sp);
 
     auto* tb=addToolBar("Nodes");
     tb->addAction("Input Node", [=](){
         QString f=QFileDialog::getOpenFileName(this,"Open Image");
-        if(f.isEmpty())return;
-        inputNodePtr=std::make_shared<InputNode>();
-        inputNodePtr->loadImage(f.toStdString());
-        graph.addNode(inputNodePtr);
-        auto* ni=new NodeItem(inputNodePtr.get(),Qt::darkGreen);
-        scene->addItem(ni);
-        if(outputNodePtr) graph.connectNodes(inputNodePtr->id,outputNodePtr->id);
-        processGraph();
+        if(!f.isEmpty()) openImage(f);
     });
     tb->addAction("Output Node", [=](){
-        outputNodePtr=std::make_shared<OutputNode>();
-        graph.addNode(outputNodePtr);
-        auto* ni=new NodeItem(outputNodePtr.get(),Qt::darkRed);
+        auto out=std::make_shared<OutputNode>();
+        outputNodePtr=out;
+        auto* ni=new NodeItem(out.get(),Qt::darkRed);
         scene->addItem(ni);
-        if(inputNodePtr) graph.connectNodes(inputNodePtr->id,outputNodePtr->id);
-        processGraph();
+        editGraph([this,in=inputNodePtr,out]{
+            graph.addNode(out);
+            worker->setOutput(out);
+            if(in) graph.connectNodes(in->id,out->id);
+        });
     });
     tb->addAction("Brightness/Contrast Node", [=](){
-        bcNodePtr=std::make_shared<BrightnessContrastNode>();
-        graph.addNode(bcNodePtr);
-        auto* ni=new NodeItem(bcNodePtr.get(),Qt::blue);
+        auto bc=std::make_shared<BrightnessContrastNode>();
+        bcNodePtr=bc;
+        auto* ni=new NodeItem(bc.get(),Qt::blue);
         scene->addItem(ni);
-        if(inputNodePtr)  graph.connectNodes(inputNodePtr->id, bcNodePtr->id);
-        if(outputNodePtr) graph.connectNodes(bcNodePtr->id, outputNodePtr->id);
         setupBCControls();
-        graph.propagateFrom(bcNodePtr.get());
-        processGraph();
+        editGraph([this,in=inputNodePtr,out=outputNodePtr,bc]{
+            graph.addNode(bc);
+            if(in)  graph.connectNodes(in->id, bc->id);
+            if(out) graph.connectNodes(bc->id, out->id);
+        });
     });
     tb->addAction("Blur Node", [=](){
-        blurNodePtr=std::make_shared<BlurNode>();
-        graph.addNode(blurNodePtr);
-        auto* ni=new NodeItem(blurNodePtr.get(),Qt::magenta);
+        auto blur=std::make_shared<BlurNode>();
+        blurNodePtr=blur;
+        auto* ni=new NodeItem(blur.get(),Qt::magenta);
         scene->addItem(ni);
-        if(inputNodePtr)  graph.connectNodes(inputNodePtr->id, blurNodePtr->id);
-        if(outputNodePtr) graph.connectNodes(blurNodePtr->id, outputNodePtr->id);
         setupBlurControls();
-        graph.propagateFrom(blurNodePtr.get());
-        processGraph();
+        editGraph([this,in=inputNodePtr,out=outputNodePtr,blur]{
+            graph.addNode(blur);
+            if(in)  graph.connectNodes(in->id, blur->id);
+            if(out) graph.connectNodes(blur->id, out->id);
+        });
     });
+    tb->addSeparator();
+    fullQualityAct=tb->addAction("Full Quality");
+    fullQualityAct->setCheckable(true);
+    connect(fullQualityAct,&QAction::toggled,this,[this](bool){ updateRenderScale(); });
+    auto* profAct=tb->addAction("Profile Overlay");
+    profAct->setCheckable(true);
+    connect(profAct,&QAction::toggled,this,[this](bool on){
+        NodeItem::showProfile=on;
+        updateProfileOverlay();
+        scene->update();
+    });
+    // A crash or a runaway blur then costs one evaluation, not the session.
+    auto* remoteAct=tb->addAction("Worker Processes");
+    remoteAct->setCheckable(true);
+    connect(remoteAct,&QAction::toggled,this,[this](bool on){
+        editGraph([this,on]{ graph.setProcessPool(on?std::make_shared<ProcessPool>():nullptr); });
+    });
+    // While idle, precompute the values next to the slider last moved.
+    speculateAct=tb->addAction("Speculate");
+    speculateAct->setCheckable(true);
+    connect(speculateAct,&QAction::toggled,this,[this](bool on){
+        if(!on) editGraph([this]{ worker->setSpeculation(nullptr); });
+    });
+}
+
+void MainWindow::updateRenderScale(){
+    if(sourceSize.empty()) return;
+    QSize view=preview->size()*preview->devicePixelRatioF();
+    double s=fullQualityAct&&fullQualityAct->isChecked() ? 1.0
+        : InputNode::proxyScaleFor(sourceSize,{view.width(),view.height()});
+    if(s!=renderScale){
+        renderScale=s;
+        editGraph([this,s]{ graph.setRenderScale(s); });
+    }
+    // Zoomed in past the proxy: render only what is on screen at full
+    // resolution, with a margin so small pans don't re-render.
+    cv::Rect region;
+    if(preview->deviceZoom()>renderScale){
+        cv::Rect vis=preview->visibleSourceRect();
+        if((vis&detailRegion)==vis&&detailRegion.area()<=4*vis.area()) return;
+        int mx=vis.width/4,my=vis.height/4;
+        region=cv::Rect(vis.x-mx,vis.y-my,vis.width+2*mx,vis.height+2*my)&cv::Rect(cv::Point(0,0),sourceSize);
+    }
+    if(region==detailRegion) return;
+    detailRegion=region;
+    editGraph([this,region]{ worker->setDetail(region); });
 }
 
 void MainWindow::setupMenu(){
     auto* m=menuBar()->addMenu("File");
-    m->addAction("Save Output", [=](){
-        QString f=QFileDialog::getSaveFileName(this,"Save Image");
+    for(bool all:{false,true})
+        m->addAction(all?"Export All Outputs...":"Export Output...", [=](){
+            if(!outputNodePtr){ QMessageBox::warning(this,"No Image","Nothing to save!"); return; }
+            QString f=QFileDialog::getSaveFileName(this,"Export Image",QString(),
+                                                   "Images (*.png *.jpg *.jpeg *.tif *.tiff *.ntf)");
+            if(f.isEmpty()||!editExportOptions())return;
+            exportOutputs(f,all);
+        });
+    m->addAction("Save Graph...", [=](){
+        QString f=QFileDialog::getSaveFileName(this,"Save Graph",QString(),"Graph (*.json *.yml)");
+        if(f.isEmpty())return;
+        editGraph([this,path=f.toStdString()]{ saveGraph(graph,path); });
+    });
+    m->addAction("Export Trace...", [=](){
+        QString f=QFileDialog::getSaveFileName(this,"Export Trace",QString(),"Chrome trace (*.json)");
         if(f.isEmpty())return;
-        QPixmap pm=previewLabel->pixmap();
-        if(pm.isNull()) QMessageBox::warning(this,"No Image","Nothing to save!");
-        else pm.save(f);
+        if(!graph.profiler().writeChromeTrace(f.toStdString()))
+            QMessageBox::critical(this,"Error","Failed to write "+f);
+    });
+    auto* v=menuBar()->addMenu("View");
+    v->addAction("Stress Test...", [=](){
+        bool ok=false;
+        int n=QInputDialog::getInt(this,"Stress Test","Nodes",5000,10,100000,1000,&ok);
+        if(ok) runStressTest(n);
+    });
+}
+
+void MainWindow::runStressTest(int count,bool quitWhenDone){
+    // Rows of 25-node chains alternating the two filter types, in a scene
+    // and graph of their own that the view shows only for the test; the
+    // user's graph never sees them.
+    constexpr int chainLen=25;
+    auto stressGraph=std::make_shared<NodeGraph>();
+    auto* stressScene=new EditorScene(this);
+    std::vector<NodeItem*> items;
+    for(int i=0;i<count;i++){
+        std::shared_ptr<Node> n;
+        if(i%2) n=std::make_shared<BlurNode>();
+        else n=std::make_shared<BrightnessContrastNode>();
+        stressGraph->addNode(n);
+        auto* ni=new NodeItem(n.get(),i%2?Qt::magenta:Qt::blue);
+        ni->setPos((i%chainLen)*200,(i/chainLen)*140);
+        stressScene->addItem(ni);
+        if(i%chainLen){
+            stressGraph->connectNodes(items.back()->backendNode->id,n->id);
+            auto* e=new EdgeItem(items.back()->outputs[0]);
+            stressScene->addItem(e);
+            e->setTarget(ni->inputs[0]);
+        }
+        items.push_back(ni);
+    }
+    QTransform savedTransform=view->transform();
+    view->setScene(stressScene);
+
+    // Two seconds each: pan at 1:1, zoom out past the level-of-detail
+    // threshold and back, and drag a block of 200 nodes.
+    static const char* phases[]={"pan","zoom","drag"};
+    struct Run{ QElapsedTimer clock; int phase=-1,frames0=0; qint64 t0=0; QStringList report; };
+    auto run=std::make_shared<Run>();
+    run->clock.start();
+    QRectF bounds=stressScene->itemsBoundingRect();
+    std::vector<NodeItem*> block(items.begin(),items.begin()+std::min<size_t>(items.size(),200));
+    auto* timer=new QTimer(this);
+    connect(timer,&QTimer::timeout,this,[=,keepAlive=stressGraph](){
+        qint64 t=run->clock.elapsed();
+        int ph=int(t/2000);
+        if(ph!=run->phase){
+            if(run->phase>=0){
+                double secs=std::max<qint64>(1,t-run->t0)/1e3;
+                run->report<<QString("%1 %2 fps").arg(phases[run->phase])
+                                                 .arg((view->frames-run->frames0)/secs,0,'f',1);
+            }
+            if(ph>=3){
+                timer->stop(); timer->deleteLater();
+                view->setScene(scene);
+                view->setTransform(savedTransform);
+                delete stressScene;   // before keepAlive, which its items point into
+                QString msg=QString("Stress test, %1 nodes: %2").arg(count).arg(run->report.join(", "));
+                statusBar()->showMessage(msg);
+                if(quitWhenDone){
+                    std::printf("%s\n",qPrintable(msg));
+                    std::fflush(stdout);
+                    qApp->quit();
+                }
+                return;
+            }
+            run->phase=ph; run->frames0=view->frames; run->t0=t;
+            view->resetTransform();
+            if(ph==2&&!block.empty()) view->centerOn(block.front());
+        }
+        double u=(t%2000)/2000.0;
+        if(ph==0){
+            view->centerOn(bounds.left()+u*bounds.width(),bounds.top()+u*bounds.height());
+        }else if(ph==1){
+            qreal z=std::pow(2.0,-5*std::sin(u*CV_PI));
+            view->setTransform(QTransform::fromScale(z,z));
+            view->centerOn(bounds.center());
+        }else{
+            qreal dx=4*std::sin(u*40);
+            for(auto* ni:block) ni->moveBy(dx,0);
+        }
     });
+    timer->start(0);
+}
+
+// What `s` sets in up to `span` single steps either side of `v`, nearest
+// first, through `toParam`, the mapping its valueChanged handler applies,
+// so each guess is the exact value a step would give the node.
+static std::vector<double> stepsAround(const QSlider* s,int v,double(*toParam)(int),int span=3){
+    std::vector<double> out;
+    for(int k=1;k<=span;k++)
+        for(int x:{v+k*s->singleStep(),v-k*s->singleStep()})
+            if(x>=s->minimum()&&x<=s->maximum()) out.push_back(toParam(x));
+    return out;
 }
 
 void MainWindow::setupBCControls(){
@@ -180,16 +501,20 @@ void MainWindow::setupBCControls(){
     L->addWidget(cSlider);
     rcBtn=new QPushButton("Reset"); L->addWidget(rcBtn);
 
-    connect(bSlider,&QSlider::valueChanged,this,[&](int v){
-        bcNodePtr->setBrightness(v);
-        graph.propagateFrom(bcNodePtr.get());
-        processGraph();
+    connect(bSlider,&QSlider::valueChanged,this,[this](int v){
+        auto steps=stepsAround(bSlider,v,[](int x){ return double(x); });
+        editGraph([this,n=bcNodePtr,v,s=speculateAct->isChecked(),steps]{
+            n->setBrightness(v);
+            worker->setSpeculation(s?n:nullptr,"brightness",steps);
+        });
     });
     connect(rbBtn,&QPushButton::clicked,this, [&](){ bSlider->setValue(0); });
-    connect(cSlider,&QSlider::valueChanged,this,[&](int v){
-        bcNodePtr->setContrast(v/100.0f);
-        graph.propagateFrom(bcNodePtr.get());
-        processGraph();
+    connect(cSlider,&QSlider::valueChanged,this,[this](int v){
+        auto steps=stepsAround(cSlider,v,[](int x){ return double(x/100.0f); });
+        editGraph([this,n=bcNodePtr,v,s=speculateAct->isChecked(),steps]{
+            n->setContrast(v/100.0f);
+            worker->setSpeculation(s?n:nullptr,"contrast",steps);
+        });
     });
     connect(rcBtn,&QPushButton::clicked,this,[&](){ cSlider->setValue(100); });
 
@@ -203,7 +528,7 @@ void MainWindow::setupBlurControls(){
     blurWidget=new QWidget(this);
     auto* L=new QVBoxLayout(blurWidget);
     L->addWidget(new QLabel("Radius"));
-    rSlider=new QSlider(Qt::Horizontal); rSlider->setRange(1,20); rSlider->setValue(1);
+    rSlider=new QSlider(Qt::Horizontal); rSlider->setRange(1,BlurNode::kMaxRadius); rSlider->setValue(1);
     L->addWidget(rSlider);
     L->addWidget(new QLabel("Mode"));
     modeCombo=new QComboBox(); modeCombo->addItems({"Uniform","Directional"});
@@ -217,29 +542,29 @@ void MainWindow::setupBlurControls(){
     L->addWidget(new QLabel("Kernel Preview"));
     kernelTable=new QTableWidget(); L->addWidget(kernelTable);
 
-    connect(rSlider,&QSlider::valueChanged,this,[&](int v){
-        blurNodePtr->setRadius(v);
+    connect(rSlider,&QSlider::valueChanged,this,[this](int v){
         updateKernelPreview();
-        graph.propagateFrom(blurNodePtr.get());
-        processGraph();
+        auto steps=stepsAround(rSlider,v,[](int x){ return double(x); });
+        editGraph([this,n=blurNodePtr,v,s=speculateAct->isChecked(),steps]{
+            n->setRadius(v);
+            worker->setSpeculation(s?n:nullptr,"radius",steps);
+        });
     });
-    connect(modeCombo,QOverload<int>::of(&QComboBox::currentIndexChanged),this,[&](int i){
-        blurNodePtr->setMode((BlurNode::Mode)i);
+    connect(modeCombo,QOverload<int>::of(&QComboBox::currentIndexChanged),this,[this](int i){
         aSlider->setEnabled(i==BlurNode::DIRECTIONAL);
         updateKernelPreview();
-        graph.propagateFrom(blurNodePtr.get());
-        processGraph();
+        editGraph([n=blurNodePtr,i]{ n->setMode((BlurNode::Mode)i); });
     });
-    connect(aSlider,&QSlider::valueChanged,this,[&](int v){
-        blurNodePtr->setAngle(v);
+    connect(aSlider,&QSlider::valueChanged,this,[this](int v){
         updateKernelPreview();
-        graph.propagateFrom(blurNodePtr.get());
-        processGraph();
+        auto steps=stepsAround(aSlider,v,[](int x){ return double(x); });
+        editGraph([this,n=blurNodePtr,v,s=speculateAct->isChecked(),steps]{
+            n->setAngle(v);
+            worker->setSpeculation(s?n:nullptr,"angle",steps);
+        });
     });
-    connect(amtSlider,&QSlider::valueChanged,this,[&](int v){
-        blurNodePtr->setAmount(v/100.0f);
-        graph.propagateFrom(blurNodePtr.get());
-        processGraph();
+    connect(amtSlider,&QSlider::valueChanged,this,[this](int v){
+        editGraph([n=blurNodePtr,v]{ n->setAmount(v/100.0f); });
     });
 
     auto* dock=new QDockWidget("Blur Controls",this);
@@ -249,11 +574,17 @@ void MainWindow::setupBlurControls(){
 }
 
 void MainWindow::updateKernelPreview(){
-    cv::Mat K=blurNodePtr->getKernel();
-    int r=K.rows,c=K.cols;
+    // Built from the widgets: the node itself belongs to the eval thread.
+    cv::Mat K=BlurNode::kernelFor(rSlider->value(),
+                                  (BlurNode::Mode)modeCombo->currentIndex(),
+                                  aSlider->value());
+    // Large radii would mean tens of thousands of cells; show the centre.
+    const int maxCells=41;
+    int r=std::min(K.rows,maxCells),c=std::min(K.cols,maxCells);
+    int oy=(K.rows-r)/2,ox=(K.cols-c)/2;
     kernelTable->clear(); kernelTable->setRowCount(r); kernelTable->setColumnCount(c);
     for(int i=0;i<r;i++)for(int j=0;j<c;j++){
-        float v=K.at<float>(i,j);
+        float v=K.at<float>(oy+i,ox+j);
         auto* it=new QTableWidgetItem(QString::number(v,'f',3));
         it->setTextAlignment(Qt::AlignCenter);
         kernelTable->setItem(i,j,it);
@@ -262,15 +593,154 @@ void MainWindow::updateKernelPreview(){
     kernelTable->resizeRowsToContents();
 }
 
-void MainWindow::processGraph(){
-    if(!inputNodePtr||!outputNodePtr) return;
-    try{
-        outputNodePtr->process();
-        cv::Mat img=outputNodePtr->getResult();
-        if(img.empty()) return;
-        QImage qi(img.data,img.cols,img.rows,img.step,QImage::Format_RGB888);
-        previewLabel->setPixmap(QPixmap::fromImage(qi));
-    } catch(const std::exception& e){
-        QMessageBox::critical(this,"Error",e.what());
+bool MainWindow::editExportOptions(){
+    QDialog d(this);
+    d.setWindowTitle("Export Options");
+    auto* form=new QFormLayout(&d);
+    auto* png=new QSpinBox; png->setRange(0,9); png->setValue(exportOptions.pngCompression);
+    auto* jpeg=new QSpinBox; jpeg->setRange(0,100); jpeg->setValue(exportOptions.jpegQuality);
+    auto* tiled=new QCheckBox("Tiled (read back a tile at a time)"); tiled->setChecked(exportOptions.tiffTiled);
+    auto* tile=new QSpinBox; tile->setRange(16,4096); tile->setSingleStep(16); tile->setValue(exportOptions.tileSize);
+    form->addRow("PNG compression",png);
+    form->addRow("JPEG quality",jpeg);
+    form->addRow("TIFF",tiled);
+    form->addRow("Tile size (TIFF, NTF)",tile);
+    auto* buttons=new QDialogButtonBox(QDialogButtonBox::Ok|QDialogButtonBox::Cancel);
+    connect(buttons,&QDialogButtonBox::accepted,&d,&QDialog::accept);
+    connect(buttons,&QDialogButtonBox::rejected,&d,&QDialog::reject);
+    form->addRow(buttons);
+    if(d.exec()!=QDialog::Accepted) return false;
+    exportOptions.pngCompression=png->value();
+    exportOptions.jpegQuality=jpeg->value();
+    exportOptions.tiffTiled=tiled->isChecked();
+    exportOptions.tileSize=tile->value();
+    return true;
+}
+
+void MainWindow::exportOutputs(const QString& path,bool all){
+    // The graph still holds the reduced stand-in; never write that out.
+    if(decoding){
+        deferredExports.push_back({path,all});
+        statusBar()->showMessage("Export waits for the full image to load...");
+        return;
+    }
+    // The eval thread only picks the outputs and copies the graph, which is
+    // cheap; the full-resolution render runs on the copy in the export's
+    // own thread, so the preview and further edits carry on meanwhile.
+    editGraph([this,path,all,out=outputNodePtr,opts=exportOptions]{
+        std::vector<std::shared_ptr<OutputNode>> outs;
+        if(all){
+            for(auto& kv:graph.nodes)
+                if(auto o=std::dynamic_pointer_cast<OutputNode>(kv.second)) outs.push_back(o);
+            std::sort(outs.begin(),outs.end(),[](auto& a,auto& b){ return a->id<b->id; });
+        }else outs.push_back(out);
+        auto copy=std::make_shared<NodeGraph>();
+        std::unordered_map<int,std::shared_ptr<Node>> copies;
+        std::string copyError="Cannot copy the graph for rendering";
+        try{ copies=cloneGraph(graph,*copy); }catch(const std::exception& e){ copyError=e.what(); }
+        QFileInfo fi(path);
+        for(auto& o:outs){
+            int id=nextExport++;
+            QString dest=outs.size()>1 ? fi.dir().filePath(QString("%1_%2.%3").arg(fi.completeBaseName()).arg(o->id).arg(fi.suffix())) : path;
+            auto post=[this](auto f){ QMetaObject::invokeMethod(this,f,Qt::QueuedConnection); };
+            post([this,id]{ setExportProgress(id,0); });
+            auto progress=[post,this,id](double f){ post([this,id,f]{ setExportProgress(id,f); }); };
+            auto done=[post,this,id,dest](const std::string& e){
+                post([this,id,dest,e=QString::fromStdString(e)]{ finishExport(id,dest,e); });
+            };
+            // An up-to-date full-resolution result is used as is.
+            if(graph.getRenderScale()==1&&!o->isDirty()&&!o->getResult().empty()){
+                exports.start(dest.toStdString(),o->getResult(),opts,progress,done);
+                continue;
+            }
+            auto it=copies.find(o->id);
+            if(it==copies.end()){ done(copyError); continue; }
+            exports.start(dest.toStdString(),[copy,node=it->second](const ExportProgress& p){
+                return Frame(TiledRenderer(ThreadPool::instance()).render(node.get(),cv::Rect(),p),node->channelOrder());
+            },opts,progress,done);
+        }
+    });
+}
+
+void MainWindow::setExportProgress(int id,double f){
+    exportProgress[id]=f;
+    updateExportBar();
+}
+
+void MainWindow::finishExport(int id,const QString& path,const QString& error){
+    exportProgress.remove(id);
+    updateExportBar();
+    if(!error.isEmpty()) QMessageBox::critical(this,"Export Failed",path+": "+error);
+    else statusBar()->showMessage("Exported "+path,5000);
+}
+
+// One bar for every export in flight, at their mean progress.
+void MainWindow::updateExportBar(){
+    if(!exportBar){
+        exportBar=new QProgressBar;
+        exportBar->setRange(0,100);
+        exportBar->setMaximumWidth(200);
+        statusBar()->addPermanentWidget(exportBar);
+    }
+    if(exportProgress.isEmpty()){ exportBar->hide(); return; }
+    double sum=0;
+    for(double v:exportProgress) sum+=v;
+    exportBar->setValue(int(100*sum/exportProgress.size()));
+    exportBar->setFormat(QString("Exporting %1: %p%").arg(exportProgress.size()));
+    exportBar->show();
+}
+
+quint64 MainWindow::editGraph(EvalWorker::Edit edit){
+    return worker->submit(std::move(edit));
+}
+
+void MainWindow::showResult(const Frame& result, quint64 generation){
+    // Queued results can arrive out of order; never step back to older state.
+    if(generation<shownGeneration) return;
+    shownGeneration=generation;
+    if(result.empty()) return;
+    // Time from choosing a file to its first pixels on screen, and to the
+    // full-resolution image when a reduced decode came first.
+    if(firstPixelGen&&generation>=firstPixelGen){
+        firstPixelGen=0;
+        loadReport=QString("First pixel %1 ms").arg(openTimer.elapsed());
+        if(previewFactor>1) loadReport+=QString(" (1/%1 decode)").arg(previewFactor);
+    }
+    if(fullPixelGen&&generation>=fullPixelGen){
+        fullPixelGen=0;
+        if(previewFactor>1) loadReport+=QString(", full image %1 ms").arg(openTimer.elapsed());
+    }
+    auto cs=graph.resultCache().stats();
+    // Counted by the graph's executor for its last evaluation, so copies
+    // made by speculation, exports and the detail render are left out.
+    auto ev=graph.profiler().last();
+    statusBar()->showMessage(QString("Evaluated in %1 ms | Full-frame copies this update: %2 | Cache: %3 hits, %4 misses, %5 MB%6")
+                             .arg(ev.durUs/1e3,0,'f',1)
+                             .arg(qulonglong(ev.copies))
+                             .arg(qulonglong(cs.hits)).arg(qulonglong(cs.misses))
+                             .arg(cs.bytes>>20)
+                             .arg(loadReport.isEmpty()?QString():" | "+loadReport));
+    updateProfileOverlay();
+    // Held by reference; the viewer converts only visible tiles that changed.
+    preview->setFrame(result,sourceSize);
+}
+
+void MainWindow::showDetail(const Frame& detail, const QRect& r, quint64 generation){
+    if(generation<shownGeneration) return;
+    preview->setDetail(detail,cv::Rect(r.x(),r.y(),r.width(),r.height()));
+}
+
+void MainWindow::updateProfileOverlay(){
+    if(!NodeItem::showProfile) return;
+    auto stats=graph.profiler().nodeStats();
+    double slowest=0;
+    for(auto& kv:stats) slowest=std::max(slowest,kv.second.lastComputedMs);
+    for(auto* it:scene->items()){
+        auto* ni=qgraphicsitem_cast<NodeItem*>(it);
+        if(!ni) continue;
+        auto s=stats.find(ni->backendNode->id);
+        if(s==stats.end()) continue;
+        double ms=s->second.lastComputedMs;
+        ni->setProfile(ms,s->second.lastStatus,slowest>0?ms/slowest:0);
     }
 }
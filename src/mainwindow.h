@@ -6,22 +6,70 @@
 #include <QGraphicsPathItem>
 #include <QtWidgets>
 #include <opencv2/opencv.hpp>
+#include <list>
 #include <memory>
 #include "node_framework.h"
+#include "eval_worker.h"
+#include "preview_view.h"
+#include "image_export.h"
 
 class PortItem;
 class EdgeItem;
 
+// Below this scale nodes are drawn as plain boxes without text or ports.
+constexpr qreal kDetailLod=0.45;
+
+// Scene for the node editor. Nodes moved during a drag only queue their
+// edges; the paths are rebuilt once per event-loop pass, however many
+// nodes moved in it.
+class EditorScene : public QGraphicsScene {
+    Q_OBJECT
+public:
+    explicit EditorScene(QObject* parent=nullptr);
+    void queueEdges(const std::vector<EdgeItem*>& edges);
+    void forgetEdge(EdgeItem* e);
+    // Topmost port within a few pixels of pos, via the scene's BSP index.
+    PortItem* portAt(const QPointF& pos) const;
+    // Attaches a dragged edge to an input, replacing the edge it had.
+    void connectPorts(EdgeItem* edge,PortItem* to);
+    // Called when the user wires two nodes together.
+    std::function<void(Node* from,Node* to)> onConnect;
+private:
+    void flushEdges();
+    QSet<EdgeItem*> pendingEdges;
+    bool flushQueued=false;
+};
+
+// Zoomable editor view; counts painted frames for the stress test.
+class EditorView : public QGraphicsView {
+public:
+    explicit EditorView(QGraphicsScene* scene);
+    int frames=0;
+protected:
+    void wheelEvent(QWheelEvent* e) override;
+    void paintEvent(QPaintEvent* e) override;
+};
+
 class NodeItem : public QGraphicsItem {
 public:
+    enum{Type=UserType+1};
     NodeItem(Node* backend, QColor color=Qt::gray);
+    int type() const override { return Type; }
     QRectF boundingRect() const override;
     void paint(QPainter*,const QStyleOptionGraphicsItem*,QWidget*) override;
+    // Profile overlay: last real run time, what the latest evaluation did,
+    // and heat in [0,1] relative to the slowest node.
+    void setProfile(double ms,RunStatus status,double heat);
+    static bool showProfile;
 
     Node* backendNode;
     std::vector<PortItem*> inputs, outputs;
+    std::vector<EdgeItem*> edges;   // attached at either end
+protected:
+    QVariant itemChange(GraphicsItemChange change,const QVariant& value) override;
 private:
     QColor color; int w=150,h=100;
+    double lastMs=-1,heat=0; RunStatus lastStatus=RunStatus::Clean;
 };
 
 class PortItem : public QGraphicsEllipseItem {
@@ -29,6 +77,9 @@ public:
     enum PortType{In,Out};
 
     PortItem(PortType t,NodeItem* parentNode,int idx);
+    // Where edges attach, in scene coordinates.
+    QPointF anchor() const { return mapToScene(rect().center()); }
+    void paint(QPainter*,const QStyleOptionGraphicsItem*,QWidget*) override;
     void mousePressEvent(QGraphicsSceneMouseEvent*) override;
     void mouseMoveEvent(QGraphicsSceneMouseEvent*) override;
     void mouseReleaseEvent(QGraphicsSceneMouseEvent*) override;
@@ -39,9 +90,14 @@ public:
 
 class EdgeItem : public QGraphicsPathItem {
 public:
+    enum{Type=UserType+3};
     EdgeItem(PortItem* from);
+    ~EdgeItem() override;
+    int type() const override { return Type; }
     void setTarget(PortItem* to);
     void updatePath(const QPointF& to);
+    // Follows both ports after a move.
+    void updatePath();
     PortItem *fromPort=nullptr,*toPort=nullptr;
 };
 
@@ -49,13 +105,67 @@ class MainWindow : public QMainWindow {
     Q_OBJECT
 public:
     MainWindow(QWidget* parent=nullptr);
+    ~MainWindow() override;
     NodeGraph graph;
-    void processGraph();
+    // Queues a graph change for the evaluation thread and re-renders.
+    // Returns the generation whose result will include it.
+    quint64 editGraph(EvalWorker::Edit edit={});
+    // Adds an input node for `path`, showing a reduced decode first where
+    // the format allows one.
+    void openImage(const QString& path);
+    // Fills the editor with `count` generated nodes, then pans, zooms and
+    // drags for a few seconds and reports the frame rate of each phase.
+    void runStressTest(int count,bool quitWhenDone=false);
 private:
+    void showResult(const Frame& result, quint64 generation);
+    void showDetail(const Frame& detail, const QRect& region, quint64 generation);
+    void updateRenderScale();
+    void updateProfileOverlay();
     void setupUI(), setupMenu(), setupBCControls(), setupBlurControls();
     void updateKernelPreview();
-    QGraphicsScene* scene;
-    QLabel* previewLabel;
+    // Asks for encoder settings; false if cancelled.
+    bool editExportOptions();
+    // Renders the current output (or every output, as path_<id>.ext) at full
+    // resolution on the eval thread and encodes on background threads.
+    void exportOutputs(const QString& path,bool all);
+    void setExportProgress(int id,double fraction);
+    void finishExport(int id,const QString& path,const QString& error);
+    void updateExportBar();
+    EditorScene* scene;
+    EditorView* view;
+    PreviewView* preview;
+    // Declared before the worker, so the worker stops before the queue joins.
+    ExportQueue exports;
+    ExportOptions exportOptions;
+    std::atomic<int> nextExport{0};
+    QMap<int,double> exportProgress;   // running exports by id
+    QProgressBar* exportBar=nullptr;
+    std::unique_ptr<EvalWorker> worker;
+    quint64 shownGeneration=0;
+    // Preview runs at a proxy scale matched to the viewer unless the full
+    // quality toggle is on, plus a full-resolution detail region once zoomed
+    // in past the proxy; Export always renders at full resolution.
+    cv::Size sourceSize;
+    double renderScale=1.0;
+    cv::Rect detailRegion;
+    QAction* fullQualityAct=nullptr;
+    QAction* speculateAct=nullptr;
+    // Progressive open: the full decode runs on a loader of its own; the
+    // generations are the results that will show the first and the full
+    // pixels. Exports asked for meanwhile wait for the full image. Opening
+    // another image cancels the loaders still decoding instead of waiting:
+    // a decode can't be interrupted, but its result is dropped.
+    struct Loader{
+        std::thread thread;
+        std::atomic<bool> cancelled{false},finished{false};
+    };
+    std::list<Loader> loaders;
+    QElapsedTimer openTimer;
+    quint64 firstPixelGen=0,fullPixelGen=0;
+    int previewFactor=1;
+    bool decoding=false;
+    std::vector<std::pair<QString,bool>> deferredExports;
+    QString loadReport;
     std::shared_ptr<InputNode> inputNodePtr;
     std::shared_ptr<OutputNode> outputNodePtr;
     std::shared_ptr<BrightnessContrastNode> bcNodePtr;
@@ -1,3 +1,107 @@
 #include "node_framework.h"
+#include "graph_executor.h"
+#include "graph_io.h"
+#include "process_pool.h"
+#include "thread_pool.h"
+#include <cctype>
+#include <filesystem>
 
-int Node::next_id = 0;
\ No newline at end of file
+int Node::next_id = 0;
+std::atomic<uint64_t> Node::generation{1};
+std::atomic<uint64_t> InputNode::next_image_id{1};
+
+bool InputNode::loadPreview(const std::string& path, int factor, cv::Size fullSize) {
+    // Only JPEG scales inside the decoder; other formats would decode in
+    // full and then shrink, slower than loading them outright.
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return char(std::tolower(c)); });
+    if ((ext != ".jpg" && ext != ".jpeg" && ext != ".jpe") || factor < 2) return false;
+    int k = factor >= 8 ? 3 : factor >= 4 ? 2 : 1;
+    int flag = k == 3 ? cv::IMREAD_REDUCED_COLOR_8 : k == 2 ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_COLOR_2;
+    cv::Mat m = cv::imread(path, flag);
+    if (m.empty()) return false;
+    setImage(Frame(), path);
+    preview = Frame(m, ChannelOrder::BGR);
+    // A size read from the file header can miss EXIF rotation; trust it
+    // only if the reduced decode agrees.
+    cv::Size estimate(m.cols << k, m.rows << k);
+    bool agrees = std::abs(fullSize.width - estimate.width) < (1 << k)
+               && std::abs(fullSize.height - estimate.height) < (1 << k);
+    previewFor = agrees ? fullSize : estimate;
+    previewLevel = k;
+    pyramid.resize(k + 1);
+    pyramid[k] = preview;
+    return true;
+}
+
+NodeGraph::NodeGraph() : executor(std::make_unique<GraphExecutor>(ThreadPool::instance())) {
+    executor->setCache(&cache);
+    executor->setProfiler(&prof);
+}
+NodeGraph::~NodeGraph() = default;
+
+bool NodeGraph::evaluate(const std::function<bool()>& cancelled) {
+    if (remote) return evaluateRemote(cancelled);
+    if (planStale) {
+        executor->compile(nodes);
+        planStale = false;
+    }
+    return executor->run(cancelled);
+}
+
+// Inputs and outputs pair up with the worker's copy of the graph by id
+// order, which graph text preserves.
+bool NodeGraph::evaluateRemote(const std::function<bool()>& cancelled) {
+    std::vector<Node*> sorted;
+    for (auto& kv : nodes) sorted.push_back(kv.second.get());
+    std::sort(sorted.begin(), sorted.end(), [](Node* a, Node* b){ return a->id < b->id; });
+    if (std::none_of(sorted.begin(), sorted.end(), [](Node* n){ return n->isDirty(); })) return true;
+
+    ProcessPool::Job job;
+    job.graph = graphToString(*this);
+    job.renderScale = renderScale;
+    std::vector<OutputNode*> outs;
+    for (Node* n : sorted) {
+        if (auto* in = dynamic_cast<InputNode*>(n)) job.inputs.push_back({in->pixels(), in->sourceId()});
+        else if (auto* o = dynamic_cast<OutputNode*>(n)) outs.push_back(o);
+    }
+    auto token = std::make_shared<std::atomic<bool>>(false);
+    job.cancelled = token;
+    auto result = remote->submit(std::move(job));
+    // A cancelled job still queued is dropped unrun; one already running
+    // finishes and its reply is ignored.
+    while (result.wait_for(std::chrono::milliseconds(5)) != std::future_status::ready)
+        if (cancelled && cancelled()) {
+            *token = true;
+            return false;
+        }
+    ProcessPool::Result frames = result.get();
+    for (size_t i = 0; i < outs.size() && i < frames.size(); i++) outs[i]->setResult(frames[i]);
+    // Keys as the executor would have made them, so the cache stays sound
+    // if the pool is detached. No local node holds this pass's pixels: an
+    // emptied output sends a later local pass back to the cache or to
+    // recompute.
+    if (planStale) {
+        executor->compile(nodes);
+        planStale = false;
+    }
+    for (Node* n : executor->plan().order) {
+        n->fingerprint = nodeFingerprint(*n);
+        if (!dynamic_cast<OutputNode*>(n))
+            for (auto& p : n->outputs) p.data = Frame();
+        n->markClean();
+    }
+    return true;
+}
+
+void NodeGraph::setReleaseIntermediates(bool on) {
+    executor->setReleaseIntermediates(on);
+}
+
+void NodeGraph::useCache(ResultCache* other) {
+    executor->setCache(other ? other : &cache);
+}
+
+void NodeGraph::setThreadBudget(int threads) {
+    GraphExecutor::setThreadBudget(threads);
+}
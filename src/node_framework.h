@@ -1,12 +1,23 @@
 // ----------------- node_framework.h -----------------
 #pragma once
+#include <atomic>
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <functional>
 #include <unordered_map>
-#include <queue>
 #include <algorithm>
 #include <opencv2/opencv.hpp>
+#include "frame.h"
+#include "frame_pool.h"
+#include "blur_kernels.h"
+#include "result_cache.h"
+#include "profiler.h"
+#include "simd_kernels.h"
+#include "tiled_image.h"
+
+class GraphExecutor;
+class ProcessPool;
 
 class Node {
 public:
@@ -16,40 +27,165 @@ public:
         Direction direction;
         DataType type;
         std::string name;
-        cv::Mat data;
+        Frame data;
         struct Connection { Node* node; int portIndex; };
         std::vector<Connection> connections;
     };
 
-    Node(const std::string& name) : name(name), id(next_id++), dirty(true) {}
+    Node(const std::string& name) : name(name), id(next_id++) {}
     virtual ~Node() = default;
 
     virtual void process() = 0;
 
-    void connectTo(Node* target, int outputPort = 0, int inputPort = 0) {
+    // --- Named parameters (graph files, batch tools) ---
+    virtual std::string typeName() const = 0;
+    virtual std::vector<std::string> paramNames() const { return {}; }
+    virtual double getParam(const std::string&) const { return 0; }
+    virtual void setParam(const std::string&, double) {}
+
+    // An input port takes one source: connecting it again to the same
+    // source is a no-op, and a different source replaces the old edge.
+    // Returns false if nothing changed.
+    bool connectTo(Node* target, int outputPort = 0, int inputPort = 0) {
+        auto& in = target->inputs[inputPort].connections;
+        if (!in.empty() && in[0].node == this && in[0].portIndex == outputPort) return false;
+        target->disconnectInput(inputPort);
         outputs[outputPort].connections.push_back({target, inputPort});
-        target->inputs[inputPort].connections.push_back({this, outputPort});
-        downstream.push_back(target);
+        in.push_back({this, outputPort});
+        if (std::find(downstream.begin(), downstream.end(), target) == downstream.end())
+            downstream.push_back(target);
+        target->markDirty();
+        return true;
+    }
+    void disconnectInput(int inputPort) {
+        auto& in = inputs[inputPort].connections;
+        if (in.empty()) return;
+        for (auto& c : in) c.node->dropEdge(c.portIndex, this, inputPort);
+        in.clear();
         markDirty();
     }
 
-    bool isDirty() const { return dirty; }
-    void markClean() { dirty = false; }
+    // A node is dirty while its output reflects an older generation than
+    // its last invalidation. Stamps come from one counter, so a new one is
+    // always newer than any output.
+    bool isDirty() const { return computedAt != changedAt; }
+    void markClean() { computedAt = changedAt; touched = false; }
+    // Everything downstream of a dirty node is dirty already, so the walk
+    // stops there and costs O(V+E) of the newly invalidated subgraph. A
+    // touched node is the exception and is walked through.
     void markDirty() {
-        if (!dirty) {
-            dirty = true;
-            for (auto* c : downstream) c->markDirty();
+        if (isDirty() && !touched) return;
+        uint64_t g = ++generation;
+        std::vector<Node*> stack{this};
+        while (!stack.empty()) {
+            Node* n = stack.back();
+            stack.pop_back();
+            if (n->isDirty() && !n->touched) continue;
+            n->changedAt = g;
+            n->touched = false;
+            for (Node* d : n->downstream) if (!d->isDirty() || d->touched) stack.push_back(d);
         }
     }
+    // Dirty on its own, for an output that was released rather than
+    // changed: the node reruns, but what it feeds keeps its results.
+    void touch() {
+        if (isDirty()) return;
+        changedAt = ++generation;
+        touched = true;
+    }
+
+    // Frame produced upstream for input port i; empty if unconnected.
+    // Returned by reference so reading it doesn't add a buffer owner.
+    const Frame& inputData(int i = 0) const {
+        static const Frame none;
+        if (inputs[i].connections.empty()) return none;
+        auto& c = inputs[i].connections[0];
+        return c.node->outputs[c.portIndex].data;
+    }
+
+    // Input i's frame for a node that will write its output over it. The
+    // frame is moved out of the producer only when the executor found this
+    // node to be its last reader and nothing else holds the buffer, e.g. the
+    // cache; otherwise it is empty and the input stays read-only.
+    Frame takeInput(int i = 0) {
+        if (!lastReader || inputs[i].connections.empty()) return Frame();
+        auto& c = inputs[i].connections[0];
+        Frame& src = c.node->outputs[c.portIndex].data;
+        if (src.empty() || src.shared()) return Frame();
+        Frame f = std::move(src);
+        src = Frame();
+        return f;
+    }
+
+    // Preview renders run on a downscaled image; nodes with parameters
+    // measured in pixels scale them by this factor.
+    void setRenderScale(double s) {
+        if (s == renderScale) return;
+        renderScale = s;
+        markDirty();
+    }
+    double getRenderScale() const { return renderScale; }
+
+    // --- Tiled evaluation (always at source resolution) ---
+    // Size of the image this node produces.
+    virtual cv::Size outputSize() const {
+        if (inputs.empty() || inputs[0].connections.empty()) return cv::Size();
+        return inputs[0].connections[0].node->outputSize();
+    }
+    // Channel order of the pixels this node produces; sources decide and
+    // everything downstream inherits it.
+    virtual ChannelOrder channelOrder() const {
+        if (inputs.empty() || inputs[0].connections.empty()) return ChannelOrder::RGB;
+        return inputs[0].connections[0].node->channelOrder();
+    }
+    // Input pixels needed to produce outRect. Pointwise nodes need exactly
+    // outRect; filters add a halo.
+    virtual cv::Rect inputFootprint(const cv::Rect& outRect) const { return outRect; }
+    // Computes outRect from `in`, which holds inRect of the input image.
+    // Must be safe to call concurrently. Returns false without a tile path.
+    virtual bool processTile(const cv::Mat& in, const cv::Rect& inRect,
+                             const cv::Rect& outRect, cv::Mat& out) const {
+        return false;
+    }
+
+    // --- Pointwise fusion ---
+    // Nodes whose output pixel depends only on the same input pixel. The
+    // executor collapses runs of them into one pass over the frame.
+    virtual bool isPointwise() const { return false; }
+    // The node as a 256-entry CV_8U table for 8-bit data; false if it
+    // can't be expressed that way.
+    virtual bool pointwiseLut(cv::Mat& lut) const { return false; }
+
+    // --- Result caching ---
+    // Identity of external data a source reads (0 for derived nodes).
+    virtual uint64_t sourceId() const { return 0; }
+    // Sources and sinks are cheap to rerun; only filters go in the cache.
+    virtual bool isCacheable() const { return !inputs.empty() && !outputs.empty(); }
 
     std::string name;
     int id;
     std::vector<Port> inputs, outputs;
     std::vector<Node*> downstream;
+    uint64_t fingerprint = 0;   // key of the current output, see nodeFingerprint()
+    bool lastReader = false;    // set by the executor around process(), see takeInput()
 
     static int next_id;
 protected:
-    bool dirty;
+    double renderScale = 1.0;
+private:
+    void dropEdge(int outputPort, Node* target, int inputPort) {
+        auto& out = outputs[outputPort].connections;
+        out.erase(std::remove_if(out.begin(), out.end(), [&](const Port::Connection& c){
+            return c.node == target && c.portIndex == inputPort;
+        }), out.end());
+        for (auto& port : outputs)
+            for (auto& c : port.connections) if (c.node == target) return;
+        downstream.erase(std::remove(downstream.begin(), downstream.end(), target), downstream.end());
+    }
+
+    static std::atomic<uint64_t> generation;
+    uint64_t changedAt = 1, computedAt = 0;
+    bool touched = false;   // dirty through touch() only
 };
 
 
@@ -60,19 +196,149 @@ public:
     InputNode() : Node("Image Input") {
         outputs.emplace_back(Port{Port::OUTPUT, Port::IMAGE, "Output"});
     }
+    std::string typeName() const override { return "Input"; }
+    // Tiled files (.ntf, tiled TIFF) are only opened here; pixels are read
+    // when a level or tile is first needed. Other files are decoded whole.
+    // Either way the decoder's channel order is kept, not converted.
     void loadImage(const std::string& path) {
-        image = cv::imread(path);
-        if (image.empty()) throw std::runtime_error("Failed to load image");
-        cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
+        auto t = openTiledImage(path);
+        setImage(t ? Frame() : decode(path), path);
+        tiled = t;
+    }
+    // Fast first look at a large JPEG: the decoder itself scales it down by
+    // `factor` (2, 4 or 8), at a fraction of the cost of a full decode, and
+    // that stands in for the image until setImage() brings the full one.
+    // Returns false, changing nothing, for other files.
+    bool loadPreview(const std::string& path, int factor, cv::Size fullSize = {});
+    // Takes an already decoded image, e.g. from a batch decode stage.
+    void setImage(const Frame& img, const std::string& path = {}) {
+        image = img;
+        tiled.reset();
+        preview = Frame();
+        previewLevel = 0;
+        imageId = next_image_id++;
+        pyramid.clear();
+        sourcePath = path;
+        markDirty();
+    }
+    // Same pixels and identity as `other`, so both have one fingerprint;
+    // used by copies of a graph. Nothing is decoded or copied.
+    void shareSource(const InputNode& other) {
+        image = other.image;
+        tiled = other.tiled;
+        preview = other.preview;
+        previewFor = other.previewFor;
+        previewLevel = other.previewLevel;
+        pyramid = other.pyramid;
+        sourcePath = other.sourcePath;
+        imageId = other.imageId;
         markDirty();
     }
+    // Full decode in BGR order; throws if the file can't be read.
+    static Frame decode(const std::string& path) {
+        cv::Mat m = cv::imread(path);
+        if (m.empty()) throw std::runtime_error("Failed to load image");
+        return Frame(m, ChannelOrder::BGR);
+    }
+    const std::string& path() const { return sourcePath; }
+    // The decoded source at full size; empty for tiled files and stand-ins.
+    const Frame& pixels() const { return image; }
+    // True while only a loadPreview() stand-in is loaded.
+    bool isPreview() const { return !preview.empty(); }
+    uint64_t sourceId() const override { return imageId; }
+    cv::Size imageSize() const { return tiled ? tiled->size() : isPreview() ? previewFor : image.size(); }
+    cv::Size outputSize() const override { return imageSize(); }
+    ChannelOrder channelOrder() const override {
+        return tiled ? tiled->order() : isPreview() ? preview.order() : image.order();
+    }
+    bool processTile(const cv::Mat&, const cv::Rect&, const cv::Rect& outRect,
+                     cv::Mat& out) const override {
+        if (tiled) tiled->read(outRect, out);
+        else if (!isPreview()) out = image.mat()(outRect);
+        else {
+            // Enlarged from the stand-in; good enough until the real pixels land.
+            double sx = double(preview.size().width) / previewFor.width;
+            double sy = double(preview.size().height) / previewFor.height;
+            cv::Rect src(cv::Point(int(outRect.x * sx), int(outRect.y * sy)),
+                         cv::Point(int(std::ceil(outRect.br().x * sx)), int(std::ceil(outRect.br().y * sy))));
+            src &= cv::Rect(cv::Point(0,0), preview.size());
+            cv::resize(preview.mat()(src), out, outRect.size(), 0, 0, cv::INTER_LINEAR);
+        }
+        return true;
+    }
     void process() override {
         if (!isDirty()) return;
-        if (!image.empty()) outputs[0].data = image.clone();
+        if (!image.empty() || tiled || isPreview()) outputs[0].data = level(levelForScale(renderScale));
         markClean();
     }
+
+    // Largest power-of-two reduction that still covers a view of the given
+    // size, so the preview never has to upscale.
+    static double proxyScaleFor(cv::Size image, cv::Size view) {
+        double s = 1.0;
+        while (image.width*s/2 >= view.width && image.height*s/2 >= view.height) s /= 2;
+        return s;
+    }
 private:
-    cv::Mat image;
+    static int levelForScale(double s) {
+        int k = 0;
+        while (s <= 0.5) { s *= 2; k++; }
+        return k;
+    }
+    // Pyramid levels are built on first use and kept until the next load.
+    // Tiled files supply their stored levels, read whole: level 0, at render
+    // scale 1, is the entire image in memory. Coarser levels than the file
+    // stores are reduced from its coarsest one a band at a time, so that
+    // level is read once but never held whole. The rest come from pyrDown.
+    // A stand-in preview is its own level and finer ones are enlarged from it.
+    const Frame& level(int k) {
+        if (int(pyramid.size()) <= k) pyramid.resize(k + 1);
+        Frame& f = pyramid[k];
+        if (!f.empty()) return f;
+        if (tiled && k < tiled->levels()) {
+            cv::Mat m;
+            tiled->read(cv::Rect(cv::Point(0,0), tiled->size(k)), m, k);
+            f = Frame(m, tiled->order());
+        } else if (tiled) {
+            int top = tiled->levels() - 1, step = 1 << (k - top);
+            cv::Size src = tiled->size(top), sz = src;
+            for (int i = top; i < k; i++) sz = cv::Size((sz.width + 1) / 2, (sz.height + 1) / 2);
+            cv::Mat m(sz, tiled->type()), band;
+            int rows = std::max(1, 256 / step);   // output rows per band
+            for (int y = 0; y < sz.height; y += rows) {
+                int h = std::min(rows, sz.height - y);
+                tiled->read(cv::Rect(0, y * step, src.width, std::min(h * step, src.height - y * step)), band, top);
+                cv::Mat dst = m.rowRange(y, y + h);
+                cv::resize(band, dst, dst.size(), 0, 0, cv::INTER_AREA);
+            }
+            f = Frame(m, tiled->order());
+        } else if (isPreview() && k < previewLevel) {
+            cv::Size sz = previewFor;
+            for (int i = 0; i < k; i++) sz = cv::Size((sz.width + 1) / 2, (sz.height + 1) / 2);
+            cv::Mat up;
+            cv::resize(preview.mat(), up, sz, 0, 0, cv::INTER_LINEAR);
+            f = Frame(up, preview.order());
+        } else if (k == 0) {
+            f = image;
+        } else {
+            const Frame& up = level(k - 1);
+            if (up.size().area() <= 1) return up;
+            cv::Mat down;
+            cv::pyrDown(up.mat(), down);
+            f = Frame(down, up.order());
+        }
+        return f;
+    }
+
+    Frame image;
+    std::shared_ptr<TiledImage> tiled;
+    Frame preview;          // reduced decode standing in for `image`
+    cv::Size previewFor;    // full size of the image it stands in for
+    int previewLevel = 0;   // pyramid level the preview fills
+    std::vector<Frame> pyramid;
+    std::string sourcePath;
+    uint64_t imageId = 0;
+    static std::atomic<uint64_t> next_image_id;
 };
 
 // === Output Node ===
@@ -81,18 +347,25 @@ public:
     OutputNode() : Node("Image Output") {
         inputs.emplace_back(Port{Port::INPUT, Port::IMAGE, "Input"});
     }
+    std::string typeName() const override { return "Output"; }
     void process() override {
         if (!isDirty()) return;
-        if (!inputs[0].connections.empty()) {
-            auto& c = inputs[0].connections[0];
-            c.node->process();
-            result = c.node->outputs[c.portIndex].data.clone();
-        }
+        if (!inputs[0].connections.empty()) result = inputData();
+        markClean();
+    }
+    const Frame& getResult() const { return result; }
+    // A result computed elsewhere, e.g. in a worker process.
+    void setResult(const Frame& f) {
+        result = f;
         markClean();
     }
-    cv::Mat getResult() const { return result; }
+    bool processTile(const cv::Mat& in, const cv::Rect&, const cv::Rect&,
+                     cv::Mat& out) const override {
+        out = in;
+        return true;
+    }
 private:
-    cv::Mat result;
+    Frame result;
 };
 
 // === Brightness/Contrast Node ===
@@ -108,19 +381,71 @@ public:
     void setContrast(float c)   { contrast = std::clamp(c, 0.0f, 3.0f); markDirty(); }
     void resetBrightness()      { brightness = 0; markDirty(); }
     void resetContrast()        { contrast = 1.0f; markDirty(); }
+
+    std::string typeName() const override { return "BrightnessContrast"; }
+    std::vector<std::string> paramNames() const override { return {"brightness", "contrast"}; }
+    double getParam(const std::string& p) const override {
+        if (p == "brightness") return brightness;
+        if (p == "contrast")   return contrast;
+        return 0;
+    }
+    void setParam(const std::string& p, double v) override {
+        if (p == "brightness") setBrightness(cvRound(v));
+        if (p == "contrast")   setContrast(float(v));
+    }
     void process() override {
         if (!isDirty()) return;
-        if (inputs[0].connections.empty()) return;
-        auto& c = inputs[0].connections[0];
-        c.node->process();
-        cv::Mat in = c.node->outputs[c.portIndex].data;
-        if (in.empty()) return;
+        // Nothing in, nothing out; still clean, so downstream stays consistent.
+        if (inputData().empty()) { outputs[0].data = Frame(); markClean(); return; }
+        ChannelOrder order = inputData().order();
+        // Pointwise, so a buffer nobody else reads is simply overwritten.
+        Frame own = takeInput();
         cv::Mat out;
-        in.convertTo(out, -1, contrast, brightness);
-        outputs[0].data = out;
+        if (!own.empty()) {
+            out = own.writable();
+            apply(out, out);
+        } else {
+            out = FramePool::mat();
+            apply(inputData().mat(), out);
+        }
+        outputs[0].data = Frame(out, order);
         markClean();
     }
+    bool processTile(const cv::Mat& in, const cv::Rect&, const cv::Rect&,
+                     cv::Mat& out) const override {
+        apply(in, out);
+        return true;
+    }
+    bool isPointwise() const override { return true; }
+    // Built by the affine kernel itself, so a fused chain and a node run on
+    // its own give the same bytes whatever the compiler's contraction flags.
+    bool pointwiseLut(cv::Mat& lut) const override {
+        uchar ramp[256];
+        for (int v = 0; v < 256; v++) ramp[v] = uchar(v);
+        lut.create(1, 256, CV_8U);
+        simd::affine(ramp, lut.ptr<uchar>(), 256, contrast, float(brightness));
+        return true;
+    }
 private:
+    // 8-bit rows go through the vectorised affine kernel: a float multiply,
+    // then add, never fused, rounded half to even. convertTo, used before
+    // and still for other depths, can fuse them and so differ by 1 on ties.
+    // Passing the same Mat as in and out works in place; any other aliasing
+    // of the input is broken first.
+    void apply(const cv::Mat& in, cv::Mat& out) const {
+        if (in.depth() == CV_8U) {
+            if (out.data == in.data && &out != &in) out.release();
+            out.create(in.size(), in.type());
+            int n = in.cols * in.channels();
+            float a = contrast, b = float(brightness);
+            cv::parallel_for_(cv::Range(0, in.rows), [&](const cv::Range& rows){
+                for (int y = rows.start; y < rows.end; y++)
+                    simd::affine(in.ptr<uchar>(y), out.ptr<uchar>(y), n, a, b);
+            });
+        } else {
+            in.convertTo(out, -1, contrast, brightness);
+        }
+    }
     int brightness;
     float contrast;
 };
@@ -135,52 +460,67 @@ public:
         inputs.emplace_back(Port{Port::INPUT, Port::IMAGE, "Input"});
         outputs.emplace_back(Port{Port::OUTPUT, Port::IMAGE, "Output"});
     }
-    void setRadius(int r)   { radius = std::clamp(r, 1, 20); markDirty(); }
+    // Every blur path costs O(1) or O(r) per pixel, so large radii are fine.
+    static constexpr int kMaxRadius = 100;
+    void setRadius(int r)   { radius = std::clamp(r, 1, kMaxRadius); markDirty(); }
     void setMode(Mode m)    { mode = m; markDirty(); }
     void setAngle(float a)  { angle = std::fmod(a,360.0f); markDirty(); }
     void setAmount(float a) { amount = std::clamp(a,0.0f,1.0f); markDirty(); }
 
-    cv::Mat getKernel() const {
-        int k = radius*2+1;
-        if (mode==UNIFORM) {
-            cv::Mat g = cv::getGaussianKernel(k,-1,CV_32F);
-            return g * g.t();
-        } else {
-            cv::Mat M = cv::Mat::zeros(k,k,CV_32F);
-            cv::Point2f c((k-1)/2.0f,(k-1)/2.0f);
-            float rads = angle * CV_PI/180.0f;
-            cv::Point2f d(std::cos(rads), std::sin(rads));
-            for(int i=0;i<k;i++){
-                float t = i-(k-1)/2.0f;
-                cv::Point2f p = c + d*t;
-                int x=std::round(p.x), y=std::round(p.y);
-                if(x>=0&&x<k&&y>=0&&y<k) M.at<float>(y,x)=1;
-            }
-            return M / cv::sum(M)[0];
-        }
+    std::string typeName() const override { return "Blur"; }
+    std::vector<std::string> paramNames() const override {
+        return {"radius", "mode", "angle", "amount"};
+    }
+    double getParam(const std::string& p) const override {
+        if (p == "radius") return radius;
+        if (p == "mode")   return mode;
+        if (p == "angle")  return angle;
+        if (p == "amount") return amount;
+        return 0;
+    }
+    void setParam(const std::string& p, double v) override {
+        if (p == "radius") setRadius(cvRound(v));
+        if (p == "mode")   setMode(v >= DIRECTIONAL ? DIRECTIONAL : UNIFORM);
+        if (p == "angle")  setAngle(float(v));
+        if (p == "amount") setAmount(float(v));
+    }
+
+    cv::Mat getKernel() const { return kernelFor(radius, mode, angle); }
+    // Kernel for the given settings, usable without touching a live node.
+    static cv::Mat kernelFor(int radius, Mode mode, float angle) {
+        return blur::kernel2D(radius, mode==DIRECTIONAL, angle);
     }
 
     void process() override {
         if (!isDirty()) return;
-        if (inputs[0].connections.empty()) return;
-        auto& c = inputs[0].connections[0];
-        c.node->process();
-        cv::Mat in = c.node->outputs[c.portIndex].data;
-        if (in.empty()) return;
-        cv::Mat blurred;
-        int k = radius*2+1;
-        if (mode==UNIFORM)
-            cv::GaussianBlur(in, blurred, {k,k},0);
-        else {
-            cv::Mat K = getKernel();
-            cv::filter2D(in, blurred, -1, K);
-        }
-        cv::Mat out;
-        cv::addWeighted(blurred, amount, in, 1.0f-amount, 0, out);
-        outputs[0].data = out;
+        const cv::Mat& in = inputData().mat();
+        if (in.empty()) { outputs[0].data = Frame(); markClean(); return; }
+        // Keep the blur the same size relative to the image at proxy scale.
+        int r = cvRound(radius*renderScale);
+        if (r < 1) { outputs[0].data = inputData(); markClean(); return; }
+        cv::Mat out = FramePool::mat();
+        apply(in, r, out);
+        outputs[0].data = Frame(out, inputData().order());
         markClean();
     }
+
+    cv::Rect inputFootprint(const cv::Rect& o) const override {
+        return {o.x-radius, o.y-radius, o.width+2*radius, o.height+2*radius};
+    }
+    // The halo is clipped at the image edge, where the default reflect
+    // border then matches what a whole-frame blur sees.
+    bool processTile(const cv::Mat& in, const cv::Rect& inRect,
+                     const cv::Rect& outRect, cv::Mat& out) const override {
+        cv::Mat full;
+        apply(in, radius, full);
+        out = full(outRect - inRect.tl());
+        return true;
+    }
 private:
+    void apply(const cv::Mat& in, int r, cv::Mat& out) const {
+        blur::apply(in, out, mode==DIRECTIONAL, r, angle, amount);
+    }
+
     int radius;
     Mode mode;
     float angle, amount;
@@ -189,23 +529,56 @@ private:
 // === Node Graph ===
 class NodeGraph {
 public:
-    void addNode(std::shared_ptr<Node> n) { nodes[n->id] = n; }
+    NodeGraph();
+    ~NodeGraph();
+    void addNode(std::shared_ptr<Node> n) {
+        n->setRenderScale(renderScale);
+        nodes[n->id] = n;
+        planStale = true;
+    }
+    // Drops each intermediate frame once every node reading it this pass
+    // has run, so peak memory follows graph width rather than length; a
+    // later edit recomputes the released producers (or finds them in the
+    // cache). On by default; interactive editors keep results instead so a
+    // downstream edit reruns only that node.
+    void setReleaseIntermediates(bool on);
     void connectNodes(int s,int d,int o=0,int i=0){
-        nodes[s]->connectTo(nodes[d].get(),o,i);
-    }
-    void propagateFrom(Node* start){
-        std::queue<Node*> q;
-        start->process(); start->markClean();
-        q.push(start);
-        while(!q.empty()){
-            Node* cur = q.front(); q.pop();
-            for(auto* c: cur->downstream){
-                if(c->isDirty()){
-                    c->process(); c->markClean();
-                    q.push(c);
-                }
-            }
-        }
+        if (nodes[s]->connectTo(nodes[d].get(),o,i)) planStale = true;
+    }
+    // Brings every dirty node up to date in topological order. Returns false
+    // if cancelled() asked to stop first; unfinished nodes stay dirty.
+    bool evaluate(const std::function<bool()>& cancelled = {});
+    // 1.0 renders at source resolution; smaller values give a proxy preview.
+    void setRenderScale(double s) {
+        renderScale = s;
+        for (auto& kv : nodes) kv.second->setRenderScale(s);
     }
+    double getRenderScale() const { return renderScale; }
+    // Threads OpenCV's parallel loops may use, for every graph in the
+    // process; 0, the default, divides the pool by the graph's width. Set
+    // once at startup: a tool that evaluates N graphs at once passes its
+    // share of the cores.
+    static void setThreadBudget(int threads);
+    // Outputs memoized by fingerprint; set its budget to 0 to disable.
+    ResultCache& resultCache() { return cache; }
+    // Reads and fills `other` instead, e.g. for a copy of a graph working
+    // on its behalf; nullptr goes back to this graph's own cache.
+    void useCache(ResultCache* other);
+    // Per-node timings of recent evaluations; safe to read from any thread.
+    Profiler& profiler() { return prof; }
+    // Evaluates in worker processes instead of this one; nullptr goes back
+    // to local evaluation. Each evaluate() then sends the graph and its
+    // decoded inputs as one job and brings back only the outputs.
+    void setProcessPool(std::shared_ptr<ProcessPool> pool) { remote = std::move(pool); }
+    const std::shared_ptr<ProcessPool>& processPool() const { return remote; }
     std::unordered_map<int,std::shared_ptr<Node>> nodes;
+private:
+    bool evaluateRemote(const std::function<bool()>& cancelled);
+
+    std::shared_ptr<ProcessPool> remote;
+    ResultCache cache;
+    Profiler prof;
+    double renderScale = 1.0;
+    std::unique_ptr<GraphExecutor> executor;
+    bool planStale = true;
 };
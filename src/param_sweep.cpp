@@ -0,0 +1,272 @@
+#include "param_sweep.h"
+#include "graph_io.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+
+std::unordered_map<int, std::shared_ptr<Node>> cloneGraph(const NodeGraph& src, NodeGraph& dst) {
+    std::vector<Node*> sorted;
+    for (auto& kv : src.nodes) sorted.push_back(kv.second.get());
+    std::sort(sorted.begin(), sorted.end(), [](Node* a, Node* b){ return a->id < b->id; });
+
+    dst.setRenderScale(src.getRenderScale());
+    std::unordered_map<int, std::shared_ptr<Node>> copies;
+    for (Node* n : sorted) {
+        auto c = createNode(n->typeName());
+        if (!c) throw std::runtime_error("Cannot copy node type " + n->typeName());
+        c->name = n->name;
+        for (auto& p : n->paramNames()) c->setParam(p, n->getParam(p));
+        if (auto* in = dynamic_cast<InputNode*>(n)) static_cast<InputNode&>(*c).shareSource(*in);
+        dst.addNode(c);
+        copies[n->id] = c;
+    }
+    for (Node* n : sorted)
+        for (int i = 0; i < int(n->inputs.size()); i++)
+            for (auto& c : n->inputs[i].connections) {
+                auto it = copies.find(c.node->id);
+                if (it != copies.end()) dst.connectNodes(it->second->id, copies[n->id]->id, c.portIndex, i);
+            }
+    return copies;
+}
+
+namespace {
+
+// `roots` and every node that reads from them, directly or not.
+std::unordered_set<Node*> downstreamOf(const std::vector<Node*>& roots) {
+    std::unordered_set<Node*> seen(roots.begin(), roots.end());
+    std::vector<Node*> stack = roots;
+    while (!stack.empty()) {
+        Node* n = stack.back();
+        stack.pop_back();
+        for (Node* d : n->downstream) if (seen.insert(d).second) stack.push_back(d);
+    }
+    return seen;
+}
+
+// A copy of `src` for trying other values on the `varied` nodes. Every
+// other node the source holds a result for starts out clean with that
+// frame, so only what the varied nodes feed is recomputed, against `cache`.
+// Intermediates are kept: the next value needs them again.
+struct Variant {
+    NodeGraph graph;
+    std::unordered_map<int, std::shared_ptr<Node>> byId;   // by id in the source
+
+    Variant(const NodeGraph& src, ResultCache* cache, const std::unordered_set<Node*>& varied) {
+        byId = cloneGraph(src, graph);
+        graph.useCache(cache);
+        graph.setReleaseIntermediates(false);
+        for (auto& kv : src.nodes) {
+            Node* n = kv.second.get();
+            if (varied.count(n) || n->isDirty()) continue;
+            bool held = std::none_of(n->outputs.begin(), n->outputs.end(),
+                                     [](const Node::Port& p){ return p.data.empty(); });
+            if (!held) continue;
+            Node* c = byId[n->id].get();
+            for (size_t k = 0; k < n->outputs.size(); k++) c->outputs[k].data = n->outputs[k].data;
+            if (auto* o = dynamic_cast<OutputNode*>(n)) static_cast<OutputNode*>(c)->setResult(o->getResult());
+            c->fingerprint = n->fingerprint;
+            c->markClean();
+        }
+    }
+    Node* node(int sourceId) { return byId.at(sourceId).get(); }
+};
+
+Frame resultOf(Node* n) {
+    if (auto* o = dynamic_cast<OutputNode*>(n)) return o->getResult();
+    return n->outputs.empty() ? Frame() : n->outputs[0].data;
+}
+
+// 8-bit BGR for drawing into a sheet.
+cv::Mat displayable(const Frame& f) {
+    cv::Mat m = toBgr(f.mat(), f.order());
+    if (m.depth() != CV_8U) {
+        cv::Mat d;
+        m.convertTo(d, CV_8U, m.depth() == CV_16U ? 1.0 / 257 : 1.0);
+        m = d;
+    }
+    if (m.channels() == 1) cv::cvtColor(m, m, cv::COLOR_GRAY2BGR);
+    else if (m.channels() == 4) cv::cvtColor(m, m, cv::COLOR_BGRA2BGR);
+    return m;
+}
+
+std::string caption(const std::vector<SweepAxis>& axes, const std::vector<double>& values) {
+    std::string s;
+    char buf[64];
+    for (size_t k = 0; k < axes.size(); k++) {
+        std::snprintf(buf, sizeof buf, "%s%s=%g", k ? " " : "", axes[k].param.c_str(), values[k]);
+        s += buf;
+    }
+    return s;
+}
+
+}
+
+std::vector<double> SweepAxis::range(double from, double to, int count) {
+    std::vector<double> v;
+    for (int i = 0; i < count; i++) v.push_back(count == 1 ? from : from + (to - from) * i / (count - 1));
+    return v;
+}
+
+SweepResult sweepParameters(NodeGraph& graph, const std::vector<SweepAxis>& axes,
+                            const SweepOptions& options, const std::function<bool()>& cancelled) {
+    std::vector<Node*> swept;
+    for (auto& a : axes) {
+        auto it = graph.nodes.find(a.node);
+        if (it == graph.nodes.end()) throw std::invalid_argument("No node with id " + std::to_string(a.node));
+        auto names = it->second->paramNames();
+        if (std::find(names.begin(), names.end(), a.param) == names.end())
+            throw std::invalid_argument(it->second->typeName() + " has no parameter " + a.param);
+        swept.push_back(it->second.get());
+    }
+    int output = options.output;
+    if (output < 0) {
+        auto o = findNode<OutputNode>(graph);
+        if (!o) throw std::invalid_argument("Graph has no output node");
+        output = o->id;
+    } else if (!graph.nodes.count(output)) {
+        throw std::invalid_argument("No node with id " + std::to_string(output));
+    }
+
+    SweepResult res;
+    size_t total = 1;
+    for (auto& a : axes) total *= a.values.size();
+    for (size_t i = 0; i < total; i++) {
+        std::vector<double> combo(axes.size());
+        for (size_t k = axes.size(), r = i; k-- > 0; r /= axes[k].values.size())
+            combo[k] = axes[k].values[r % axes[k].values.size()];
+        res.combos.push_back(std::move(combo));
+    }
+    res.frames.resize(total);
+    if (total == 0) { res.complete = true; return res; }
+
+    // Upstream once, on a copy that keeps its intermediates for the lanes.
+    ResultCache* cache = &graph.resultCache();
+    Variant base(graph, cache, {});
+    if (!base.graph.evaluate(cancelled)) return res;
+
+    int hw = int(std::max(1u, std::thread::hardware_concurrency()));
+    int lanes = int(std::min<size_t>(total, options.parallel > 0 ? options.parallel : std::max(1, hw / 2)));
+    std::vector<Node*> baseSwept;
+    for (auto& a : axes) baseSwept.push_back(base.node(a.node));
+    auto varied = downstreamOf(baseSwept);
+
+    // Lane nodes are addressed by base id, base nodes by graph id.
+    std::vector<std::unique_ptr<Variant>> variants;
+    for (int l = 0; l < lanes; l++)
+        variants.push_back(std::make_unique<Variant>(base.graph, cache, varied));
+
+    std::atomic<size_t> next{0};
+    std::atomic<bool> stopped{false};
+    std::atomic<int> running{lanes};
+    std::mutex m;
+    std::exception_ptr failure;
+    std::vector<std::thread> threads;
+    for (auto& vp : variants) threads.emplace_back([&, v = vp.get()]{
+        try {
+            std::vector<Node*> targets;
+            for (auto& a : axes) targets.push_back(v->node(base.byId[a.node]->id));
+            Node* out = v->node(base.byId[output]->id);
+            for (size_t i; !stopped && (i = next++) < total; ) {
+                for (size_t k = 0; k < axes.size(); k++) targets[k]->setParam(axes[k].param, res.combos[i][k]);
+                if (!v->graph.evaluate([&]{ return bool(stopped); })) break;
+                res.frames[i] = resultOf(out);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lk(m);
+            if (!failure) failure = std::current_exception();
+            stopped = true;
+        }
+        running--;
+    });
+    // cancelled() is only ever asked on the calling thread.
+    while (running > 0) {
+        if (cancelled && cancelled()) stopped = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    for (auto& t : threads) t.join();
+    if (failure) std::rethrow_exception(failure);
+    res.complete = !stopped;
+
+    if (options.cellWidth > 0) {
+        std::vector<std::string> captions;
+        if (options.captions)
+            for (auto& c : res.combos) captions.push_back(caption(axes, c));
+        int columns = axes.size() >= 2 ? int(axes.back().values.size())
+                                       : int(std::ceil(std::sqrt(double(total))));
+        res.sheet = contactSheet(res.frames, columns, options.cellWidth, captions);
+    }
+    return res;
+}
+
+Frame contactSheet(const std::vector<Frame>& frames, int columns, int cellWidth,
+                   const std::vector<std::string>& captions) {
+    auto first = std::find_if(frames.begin(), frames.end(), [](const Frame& f){ return !f.empty(); });
+    if (first == frames.end() || cellWidth <= 0) return Frame();
+    columns = std::clamp(columns, 1, int(frames.size()));
+    int rows = (int(frames.size()) + columns - 1) / columns;
+    // Cells take the first frame's aspect; others are fitted inside.
+    int cellHeight = std::max(1, cvRound(double(cellWidth) * first->size().height / first->size().width));
+    const int pad = 4, font = cv::FONT_HERSHEY_SIMPLEX;
+    const double fontScale = 0.4;
+    int baseline = 0;
+    cv::Size text = cv::getTextSize("Ag", font, fontScale, 1, &baseline);
+    int captionHeight = captions.empty() ? 0 : text.height + baseline + pad;
+
+    cv::Mat sheet(pad + rows * (cellHeight + captionHeight + pad), pad + columns * (cellWidth + pad),
+                  CV_8UC3, cv::Scalar::all(32));
+    for (size_t i = 0; i < frames.size(); i++) {
+        int x = pad + int(i % columns) * (cellWidth + pad);
+        int y = pad + int(i / columns) * (cellHeight + captionHeight + pad);
+        if (!frames[i].empty()) {
+            cv::Mat px = displayable(frames[i]), cell;
+            double s = std::min(double(cellWidth) / px.cols, double(cellHeight) / px.rows);
+            cv::Size sz(std::max(1, cvRound(px.cols * s)), std::max(1, cvRound(px.rows * s)));
+            cv::resize(px, cell, sz, 0, 0, cv::INTER_AREA);
+            cv::Mat roi = sheet(cv::Rect(x + (cellWidth - sz.width) / 2, y + (cellHeight - sz.height) / 2,
+                                         sz.width, sz.height));
+            cell.copyTo(roi);
+        }
+        if (i < captions.size())
+            cv::putText(sheet, captions[i], cv::Point(x, y + cellHeight + pad + text.height),
+                        font, fontScale, cv::Scalar::all(220), 1, cv::LINE_AA);
+    }
+    return Frame(sheet, ChannelOrder::BGR);
+}
+
+void Speculator::start(NodeGraph& graph, int node, const std::string& param,
+                       const std::vector<double>& values, std::function<bool()> cancelled) {
+    stop();
+    auto it = graph.nodes.find(node);
+    if (it == graph.nodes.end() || values.empty()) return;
+    stopping = false;
+    Node* target = it->second.get();
+    double current = target->getParam(param);
+    auto varied = downstreamOf({target});
+    int lanes = std::min(parallel, int(values.size()));
+    auto next = std::make_shared<std::atomic<size_t>>(0);
+    for (int l = 0; l < lanes; l++) {
+        auto v = std::make_shared<Variant>(graph, &graph.resultCache(), varied);
+        threads.emplace_back([this, v, node, param, values, current, next, cancelled]{
+            auto stop = [&]{ return stopping || (cancelled && cancelled()); };
+            Node* copy = v->node(node);
+            try {
+                for (size_t i; !stop() && (i = (*next)++) < values.size(); ) {
+                    copy->setParam(param, values[i]);
+                    if (copy->getParam(param) == current) continue;   // clamped onto the live value
+                    if (v->graph.evaluate(stop)) done++;
+                }
+            } catch (const std::exception&) {
+                // Only a guess; the real evaluation reports the failure.
+            }
+        });
+    }
+}
+
+void Speculator::stop() {
+    stopping = true;
+    for (auto& t : threads) t.join();
+    threads.clear();
+}
@@ -0,0 +1,85 @@
+// ----------------- param_sweep.h -----------------
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "node_framework.h"
+
+// Copies `src` into the empty graph `dst`: same node types, named
+// parameters, edges and render scale. Inputs share the source's pixels and
+// identity, so every copy has its original's fingerprint and either graph
+// can use the other's cache entries. Returns the copies by original id.
+// Call on the thread that owns `src`.
+std::unordered_map<int, std::shared_ptr<Node>> cloneGraph(const NodeGraph& src, NodeGraph& dst);
+
+// === Parameter sweep ===
+// `param` of node `node` (an id in the swept graph) takes each of `values`.
+struct SweepAxis {
+    int node = -1;
+    std::string param;
+    std::vector<double> values;
+    // `count` values evenly spaced from `from` to `to`, both included.
+    static std::vector<double> range(double from, double to, int count);
+};
+
+struct SweepOptions {
+    int output = -1;        // node whose result is collected; -1: first output node
+    int parallel = 0;       // combinations evaluated at once; 0: half the cores
+    int cellWidth = 256;    // contact sheet cell width; 0: no sheet
+    bool captions = true;   // parameter values under each cell
+};
+
+struct SweepResult {
+    std::vector<std::vector<double>> combos;    // one value per axis; the last axis varies fastest
+    std::vector<Frame> frames;                  // per combination; empty if cancelled before it
+    Frame sheet;                                // rows follow the first axes, columns the last
+    bool complete = false;
+};
+
+// Evaluates every combination of the axes' values at the graph's render
+// scale. Upstream of the swept nodes is evaluated once and shared by all
+// combinations; each parallel lane then reruns only what the swept nodes
+// feed, and results go through the graph's cache both ways. The graph
+// itself is left as it was. Throws std::invalid_argument for an unknown
+// node or parameter.
+SweepResult sweepParameters(NodeGraph& graph, const std::vector<SweepAxis>& axes,
+                            const SweepOptions& options = {},
+                            const std::function<bool()>& cancelled = {});
+
+// Frames scaled to `cellWidth` and laid out `columns` to a row in BGR
+// order, each with its caption, if any, underneath.
+Frame contactSheet(const std::vector<Frame>& frames, int columns, int cellWidth = 256,
+                   const std::vector<std::string>& captions = {});
+
+// === Speculative precompute ===
+// While a graph is idle, evaluates copies of it with one parameter of one
+// node set to values near its current one, nearest first, so stepping a
+// control there finds every changed node in the graph's cache. The graph
+// itself is never touched, and copies rerun only what that node feeds.
+class Speculator {
+public:
+    explicit Speculator(int parallel = 2) : parallel(std::max(1, parallel)) {}
+    ~Speculator() { stop(); }
+    Speculator(const Speculator&) = delete;
+    Speculator& operator=(const Speculator&) = delete;
+
+    // Replaces any earlier run. Call on the graph's thread right after it
+    // evaluated; the run stops at the next node once cancelled() is true,
+    // and must be stopped before the graph goes away.
+    void start(NodeGraph& graph, int node, const std::string& param,
+               const std::vector<double>& values, std::function<bool()> cancelled);
+    // Cancels the run and waits for it.
+    void stop();
+    // Values evaluated in full so far.
+    uint64_t computed() const { return done; }
+
+private:
+    int parallel;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> done{0};
+    std::vector<std::thread> threads;
+};
@@ -0,0 +1,232 @@
+#include "preview_view.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+quint64 tileKey(int k, int tx, int ty) {
+    return (quint64(k) << 48) | (quint64(ty) << 24) | quint64(tx);
+}
+
+// Wraps 8-bit pixels without copying; other depths go through `hold`.
+QImage wrap(cv::Mat px, ChannelOrder order, cv::Mat& hold) {
+    if (px.depth() != CV_8U) {
+        double a = px.depth() == CV_16U ? 1.0/257 : px.depth() >= CV_32F ? 255.0 : 1.0;
+        px.convertTo(hold, CV_8U, a);
+        px = hold;
+    }
+    bool bgr = order == ChannelOrder::BGR;
+    QImage::Format fmt = px.channels() == 1 ? QImage::Format_Grayscale8
+        : px.channels() == 4 ? (bgr ? QImage::Format_ARGB32 : QImage::Format_RGBA8888)
+        : bgr ? QImage::Format_BGR888 : QImage::Format_RGB888;
+    return QImage(px.data, px.cols, px.rows, int(px.step), fmt);
+}
+
+// Snaps both edges to whole pixels so neighbouring tiles meet without seams.
+QRect snap(const QRectF& r) {
+    QPoint tl(qRound(r.left()), qRound(r.top())), br(qRound(r.right()), qRound(r.bottom()));
+    return QRect(tl, br - QPoint(1, 1));
+}
+
+}
+
+PreviewView::PreviewView(QWidget* parent) : QWidget(parent) {
+    tiles.setMaxCost(256 * 1024);
+    setMinimumSize(400, 300);
+    setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Ignored);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void PreviewView::setFrame(const Frame& frame, cv::Size sourceSize) {
+    const cv::Mat& m = frame.mat();
+    if (m.empty()) return;
+    if (sourceSize.empty()) sourceSize = m.size();
+    if (sourceSize != source) {
+        source = sourceSize;
+        detail = Frame();
+        detailRegion = cv::Rect();
+        fit = true;
+    }
+    if (!levels.empty()) {
+        const Frame& old = levels[0].frame;
+        bool sameLayout = old.mat().size() == m.size() && old.mat().type() == m.type()
+                       && old.order() == frame.order();
+        // Shared buffers are immutable, so the same data pointer means the
+        // same pixels; otherwise compare and keep every tile that matches.
+        if (sameLayout && (old.mat().data == m.data || !evictChanged(old.mat(), m))) {
+            levels[0].frame = frame;
+            update();
+            return;
+        }
+        if (!sameLayout) tiles.clear();
+    }
+    levels.clear();
+    levels.push_back({frame, double(m.cols) / source.width});
+    if (fit) fitToWindow();
+    else update();
+}
+
+void PreviewView::setDetail(const Frame& frame, const cv::Rect& region) {
+    detail = frame;
+    detailRegion = region;
+    update();
+}
+
+void PreviewView::fitToWindow() {
+    fit = true;
+    if (!source.empty()) {
+        zoom = std::min(double(width()) / source.width, double(height()) / source.height);
+        origin = QPointF(source.width / 2.0, source.height / 2.0) - QPointF(width(), height()) / (2 * zoom);
+    }
+    update();
+    emit viewChanged();
+}
+
+cv::Rect PreviewView::visibleSourceRect() const {
+    QPointF a = toSource(QPointF(0, 0)), b = toSource(QPointF(width(), height()));
+    cv::Rect r(cv::Point(int(std::floor(a.x())), int(std::floor(a.y()))),
+               cv::Point(int(std::ceil(b.x())), int(std::ceil(b.y()))));
+    return r & cv::Rect(cv::Point(0, 0), source);
+}
+
+const PreviewView::Level& PreviewView::level(int k) {
+    while (int(levels.size()) <= k) {
+        Frame prev = levels.back().frame;
+        double s = levels.back().scale / 2;
+        const cv::Mat& m = prev.mat();
+        cv::Mat half;
+        cv::resize(m, half, cv::Size((m.cols + 1) / 2, (m.rows + 1) / 2), 0, 0, cv::INTER_AREA);
+        levels.push_back({Frame(half, prev.order()), s});
+    }
+    return levels[k];
+}
+
+// Coarsest level that still has at least one pixel per device pixel.
+int PreviewView::levelFor(double dz) {
+    int k = 0;
+    double s = levels[0].scale;
+    cv::Size sz = levels[0].frame.mat().size();
+    while (s / 2 >= dz && std::min(sz.width, sz.height) > 1) {
+        s /= 2;
+        sz = cv::Size((sz.width + 1) / 2, (sz.height + 1) / 2);
+        k++;
+    }
+    return k;
+}
+
+const QPixmap* PreviewView::tile(int k, int tx, int ty) {
+    quint64 key = tileKey(k, tx, ty);
+    if (QPixmap* p = tiles.object(key)) return p;
+    const Level& L = level(k);
+    const cv::Mat& m = L.frame.mat();
+    cv::Rect r = cv::Rect(tx * kTile, ty * kTile, kTile, kTile) & cv::Rect(0, 0, m.cols, m.rows);
+    if (r.empty()) return nullptr;
+    cv::Mat hold;
+    // The only conversion of these pixels; it covers one tile, not the frame.
+    auto* pm = new QPixmap(QPixmap::fromImage(wrap(m(r), L.frame.order(), hold)));
+    tiles.insert(key, pm, std::max(1, r.area() * 4 / 1024));
+    return tiles.object(key);
+}
+
+// Drops the cached tiles of every level whose source pixels differ between
+// the two frames. Returns false if nothing changed.
+bool PreviewView::evictChanged(const cv::Mat& before, const cv::Mat& after) {
+    int gx = (after.cols + kTile - 1) / kTile, gy = (after.rows + kTile - 1) / kTile;
+    std::vector<char> changed(size_t(gx) * gy, 0);
+    size_t es = after.elemSize();
+    cv::parallel_for_(cv::Range(0, gy), [&](const cv::Range& range){
+        for (int ty = range.start; ty < range.end; ty++) {
+            char* row = &changed[size_t(ty) * gx];
+            for (int y = ty * kTile; y < std::min(after.rows, (ty + 1) * kTile); y++)
+                for (int tx = 0; tx < gx; tx++) {
+                    if (row[tx]) continue;
+                    size_t off = size_t(tx) * kTile * es, n = size_t(std::min(kTile, after.cols - tx * kTile)) * es;
+                    row[tx] = std::memcmp(before.ptr(y) + off, after.ptr(y) + off, n) != 0;
+                }
+        }
+    });
+    if (std::find(changed.begin(), changed.end(), 1) == changed.end()) return false;
+
+    for (quint64 key : tiles.keys()) {
+        int k = int(key >> 48), ty = int((key >> 24) & 0xffffff), tx = int(key & 0xffffff);
+        // Level k pixels are area averages of 2^k blocks; one pixel of margin
+        // covers the blending at odd sizes.
+        int f = 1 << k;
+        int cx0 = std::max(0, (tx * kTile - 1) * f / kTile), cx1 = std::min(gx - 1, ((tx + 1) * kTile + 1) * f / kTile);
+        int cy0 = std::max(0, (ty * kTile - 1) * f / kTile), cy1 = std::min(gy - 1, ((ty + 1) * kTile + 1) * f / kTile);
+        bool dirty = false;
+        for (int cy = cy0; cy <= cy1 && !dirty; cy++)
+            for (int cx = cx0; cx <= cx1 && !dirty; cx++)
+                dirty = changed[size_t(cy) * gx + cx];
+        if (dirty) tiles.remove(key);
+    }
+    return true;
+}
+
+void PreviewView::paintEvent(QPaintEvent*) {
+    QPainter p(this);
+    p.fillRect(rect(), QColor(32, 32, 32));
+    if (levels.empty()) return;
+    double dz = deviceZoom();
+    int k = levelFor(dz);
+    const Level& L = level(k);
+    const cv::Mat& m = L.frame.mat();
+    // Smooth when reducing; past 1:1 show the pixels as they are.
+    p.setRenderHint(QPainter::SmoothPixmapTransform, dz <= L.scale);
+
+    QPointF a = toSource(QPointF(0, 0)) * L.scale, b = toSource(QPointF(width(), height())) * L.scale;
+    int tx0 = std::max(0, int(std::floor(a.x() / kTile))), tx1 = std::min((m.cols - 1) / kTile, int(std::floor(b.x() / kTile)));
+    int ty0 = std::max(0, int(std::floor(a.y() / kTile))), ty1 = std::min((m.rows - 1) / kTile, int(std::floor(b.y() / kTile)));
+    for (int ty = ty0; ty <= ty1; ty++)
+        for (int tx = tx0; tx <= tx1; tx++) {
+            const QPixmap* pm = tile(k, tx, ty);
+            if (!pm) continue;
+            QRectF src(tx * kTile / L.scale, ty * kTile / L.scale, pm->width() / L.scale, pm->height() / L.scale);
+            p.drawPixmap(snap(QRectF((src.topLeft() - origin) * zoom, src.size() * zoom)), *pm);
+        }
+
+    // Full-resolution pixels for the visible region, when the base frame
+    // is coarser than the screen.
+    if (!detail.empty() && dz > levels[0].scale) {
+        cv::Mat hold;
+        QRectF src(detailRegion.x, detailRegion.y, detailRegion.width, detailRegion.height);
+        p.drawImage(snap(QRectF((src.topLeft() - origin) * zoom, src.size() * zoom)),
+                    wrap(detail.mat(), detail.order(), hold));
+    }
+}
+
+void PreviewView::resizeEvent(QResizeEvent*) {
+    if (fit) fitToWindow();
+    else emit viewChanged();
+}
+
+void PreviewView::wheelEvent(QWheelEvent* e) {
+    // Zoom about the cursor: the source point under it stays put.
+    QPointF at = e->position(), s = toSource(at);
+    zoom = std::clamp(zoom * std::pow(1.25, e->angleDelta().y() / 120.0), 1e-3, 64.0);
+    origin = s - at / zoom;
+    fit = false;
+    update();
+    emit viewChanged();
+}
+
+void PreviewView::mousePressEvent(QMouseEvent* e) {
+    dragFrom = e->pos();
+}
+
+void PreviewView::mouseMoveEvent(QMouseEvent* e) {
+    if (!(e->buttons() & Qt::LeftButton)) return;
+    origin -= QPointF(e->pos() - dragFrom) / zoom;
+    dragFrom = e->pos();
+    fit = false;
+    update();
+    emit viewChanged();
+}
+
+void PreviewView::mouseDoubleClickEvent(QMouseEvent*) {
+    fitToWindow();
+}
@@ -0,0 +1,63 @@
+// ----------------- preview_view.h -----------------
+#pragma once
+#include <QCache>
+#include <QPixmap>
+#include <QWidget>
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "frame.h"
+
+// Zoomable, pannable view of the graph result. Frames are held by reference
+// and drawn straight from their pixels: only the tiles of the pyramid level
+// that matches the current zoom and lie in the viewport are converted into
+// pixmaps, and a new frame evicts only the cached tiles whose pixels changed.
+// When zoomed past the resolution of the base frame, a detail frame covering
+// just the visible region is drawn on top.
+class PreviewView : public QWidget {
+    Q_OBJECT
+public:
+    explicit PreviewView(QWidget* parent=nullptr);
+
+    // `frame` covers the whole source image of `sourceSize`, possibly at a
+    // proxy scale. A different source size resets the view to fit.
+    void setFrame(const Frame& frame, cv::Size sourceSize);
+    // Full-resolution pixels for `region` of the source image.
+    void setDetail(const Frame& frame, const cv::Rect& region);
+    void fitToWindow();
+
+    // Device pixels per source pixel at the current zoom.
+    double deviceZoom() const { return zoom*devicePixelRatioF(); }
+    // Part of the source image currently on screen.
+    cv::Rect visibleSourceRect() const;
+
+signals:
+    // Zoom, pan or size changed; the resolution the preview needs may differ.
+    void viewChanged();
+
+protected:
+    void paintEvent(QPaintEvent*) override;
+    void resizeEvent(QResizeEvent*) override;
+    void wheelEvent(QWheelEvent*) override;
+    void mousePressEvent(QMouseEvent*) override;
+    void mouseMoveEvent(QMouseEvent*) override;
+    void mouseDoubleClickEvent(QMouseEvent*) override;
+
+private:
+    struct Level { Frame frame; double scale; };   // scale: level pixels per source pixel
+    const Level& level(int k);
+    int levelFor(double deviceZoom);
+    const QPixmap* tile(int k, int tx, int ty);
+    bool evictChanged(const cv::Mat& before, const cv::Mat& after);
+    QPointF toSource(const QPointF& p) const { return origin + p/zoom; }
+
+    static constexpr int kTile = 256;
+    std::vector<Level> levels;          // levels[0] is the frame as given
+    QCache<quint64,QPixmap> tiles;      // cost in KB
+    cv::Size source;
+    Frame detail;
+    cv::Rect detailRegion;
+    double zoom=1;                      // widget pixels per source pixel
+    QPointF origin;                     // source point at the widget's top left
+    bool fit=true;
+    QPoint dragFrom;
+};
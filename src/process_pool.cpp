@@ -0,0 +1,532 @@
+#include "process_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include "frame_pool.h"
+#include "graph_io.h"
+#ifndef _WIN32
+#include <climits>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+#ifndef _WIN32
+namespace {
+
+constexpr int kWorkerFd = 3;   // the worker's end of its socket
+
+// Line-framed messages over a stream socket; reads can carry a deadline.
+struct Channel {
+    int fd = -1;
+    std::string buf;
+
+    // False at end of stream, on error, or once `deadline` passes.
+    bool fill(Clock::time_point deadline, bool& timedOut) {
+        for (;;) {
+            int ms = -1;
+            if (deadline != Clock::time_point::max()) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+                if (left <= 0) { timedOut = true; return false; }
+                ms = int(std::min<long long>(left, INT_MAX));
+            }
+            pollfd p{fd, POLLIN, 0};
+            int r = poll(&p, 1, ms);
+            if (r == 0 || (r < 0 && errno == EINTR)) continue;
+            if (r < 0) return false;
+            char tmp[65536];
+            ssize_t n = read(fd, tmp, sizeof tmp);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            buf.append(tmp, size_t(n));
+            return true;
+        }
+    }
+    bool readLine(std::string& line, Clock::time_point deadline, bool& timedOut) {
+        size_t eol;
+        while ((eol = buf.find('\n')) == std::string::npos)
+            if (!fill(deadline, timedOut)) return false;
+        line = buf.substr(0, eol);
+        buf.erase(0, eol + 1);
+        return true;
+    }
+    bool readExact(std::string& out, size_t n, Clock::time_point deadline, bool& timedOut) {
+        while (buf.size() < n)
+            if (!fill(deadline, timedOut)) return false;
+        out = buf.substr(0, n);
+        buf.erase(0, n);
+        return true;
+    }
+    // A dead peer is an error here rather than a SIGPIPE.
+    bool write(const std::string& s) {
+        for (size_t off = 0; off < s.size(); ) {
+            ssize_t n = send(fd, s.data() + off, s.size() - off, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            off += size_t(n);
+        }
+        return true;
+    }
+};
+
+// A POSIX shared memory segment mapped into this process.
+class Segment {
+public:
+    Segment() = default;
+    Segment(Segment&& o) noexcept : base(o.base), len(o.len) { o.base = nullptr; o.len = 0; }
+    Segment& operator=(Segment&& o) noexcept { std::swap(base, o.base); std::swap(len, o.len); return *this; }
+    ~Segment() { if (base) munmap(base, len); }
+
+    // `name` must not exist yet.
+    static Segment create(const std::string& name, size_t bytes) {
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) throw std::runtime_error("Cannot create shared memory " + name);
+        Segment s;
+        if (ftruncate(fd, off_t(bytes)) == 0) s.map(fd, bytes, PROT_READ | PROT_WRITE);
+        close(fd);
+        if (!s.base) {
+            shm_unlink(name.c_str());
+            throw std::runtime_error("Cannot map shared memory " + name);
+        }
+        return s;
+    }
+    static Segment openReadOnly(const std::string& name) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) throw std::runtime_error("Cannot open shared memory " + name);
+        Segment s;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) s.map(fd, size_t(st.st_size), PROT_READ);
+        close(fd);
+        if (!s.base) throw std::runtime_error("Cannot map shared memory " + name);
+        return s;
+    }
+
+    uchar* data() const { return static_cast<uchar*>(base); }
+    size_t size() const { return len; }
+
+private:
+    void map(int fd, size_t bytes, int prot) {
+        void* p = mmap(nullptr, bytes, prot, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) { base = p; len = bytes; }
+    }
+    void* base = nullptr;
+    size_t len = 0;
+};
+
+// Where one frame sits in a segment.
+struct Desc {
+    int rows = 0, cols = 0, type = 0, order = 0;
+    size_t offset = 0;
+    size_t bytes() const { return size_t(rows) * cols * CV_ELEM_SIZE(type); }
+};
+
+std::istream& operator>>(std::istream& is, Desc& d) {
+    return is >> d.rows >> d.cols >> d.type >> d.order >> d.offset;
+}
+
+size_t padded(size_t n) { return (n + 63) & ~size_t(63); }
+
+// Copies `frames` into a new segment `name`, one after another on 64-byte
+// boundaries, and returns " rows cols type order offset" for each. No
+// segment is made if every frame is empty.
+std::string packFrames(const std::vector<Frame>& frames, const std::string& name, Segment& seg) {
+    size_t total = 0;
+    for (auto& f : frames) total += padded(f.bytes());
+    if (total) seg = Segment::create(name, total);
+    std::ostringstream desc;
+    size_t off = 0;
+    for (auto& f : frames) {
+        const cv::Mat& m = f.mat();
+        desc << " " << m.rows << " " << m.cols << " " << m.type() << " " << int(f.order()) << " " << off;
+        if (m.empty()) continue;
+        size_t row = m.cols * m.elemSize();
+        if (m.isContinuous()) std::memcpy(seg.data() + off, m.data, row * m.rows);
+        else for (int y = 0; y < m.rows; y++) std::memcpy(seg.data() + off + y * row, m.ptr(y), row);
+        off += padded(f.bytes());
+    }
+    return desc.str();
+}
+
+const uchar* locate(const Segment& seg, const Desc& d) {
+    if (d.offset + d.bytes() > seg.size()) throw std::runtime_error("Frame overruns shared memory");
+    return seg.data() + d.offset;
+}
+
+std::vector<Node*> byId(const NodeGraph& g) {
+    std::vector<Node*> sorted;
+    for (auto& kv : g.nodes) sorted.push_back(kv.second.get());
+    std::sort(sorted.begin(), sorted.end(), [](Node* a, Node* b){ return a->id < b->id; });
+    return sorted;
+}
+
+// Same node types, input files and edges, pairing nodes by id order; only
+// parameters may differ.
+bool sameShape(const NodeGraph& a, const NodeGraph& b) {
+    auto x = byId(a), y = byId(b);
+    if (x.size() != y.size()) return false;
+    std::unordered_map<int, size_t> ix, iy;
+    for (size_t i = 0; i < x.size(); i++) { ix[x[i]->id] = i; iy[y[i]->id] = i; }
+    for (size_t i = 0; i < x.size(); i++) {
+        if (x[i]->typeName() != y[i]->typeName() || x[i]->inputs.size() != y[i]->inputs.size()) return false;
+        auto* in = dynamic_cast<InputNode*>(x[i]);
+        if (in && in->path() != static_cast<InputNode*>(y[i])->path()) return false;
+        for (size_t k = 0; k < x[i]->inputs.size(); k++) {
+            auto& cx = x[i]->inputs[k].connections;
+            auto& cy = y[i]->inputs[k].connections;
+            if (cx.size() != cy.size()) return false;
+            for (size_t j = 0; j < cx.size(); j++)
+                if (ix[cx[j].node->id] != iy[cy[j].node->id] || cx[j].portIndex != cy[j].portIndex) return false;
+        }
+    }
+    return true;
+}
+
+// Sets on `to` each parameter `from`, of the same shape, holds differently;
+// only the nodes that changed and what they feed go dirty.
+void copyChangedParams(const NodeGraph& from, NodeGraph& to) {
+    auto a = byId(from), b = byId(to);
+    for (size_t i = 0; i < a.size(); i++)
+        for (auto& p : a[i]->paramNames()) {
+            double v = a[i]->getParam(p);
+            if (b[i]->getParam(p) != v) b[i]->setParam(p, v);
+        }
+}
+
+std::string defaultExecutable() {
+    char buf[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", buf, sizeof buf - 1);
+    std::string self = n > 0 ? std::string(buf, size_t(n)) : std::string();
+    size_t slash = self.rfind('/');
+    return (slash == std::string::npos ? std::string(".") : self.substr(0, slash)) + "/node_batch";
+}
+
+}
+
+// A source image copied into shared memory, unlinked once evicted and no
+// job holds it. Workers copy it out, so it need not outlive their use.
+struct ProcessPool::Resident {
+    std::string name, desc;     // desc: " rows cols type order offset"
+    size_t bytes = 0;
+    int inFlight = 0;           // running jobs that name it
+    uint64_t lastUsed = 0;
+    Segment seg;
+    ~Resident() { shm_unlink(name.c_str()); }
+};
+
+struct ProcessPool::Worker {
+    pid_t pid = -1;
+    Channel ch;
+
+    void start(const std::string& exe, int threads, size_t cacheBytes) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+            throw std::runtime_error("Cannot create worker socket");
+        posix_spawn_file_actions_t fa;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_adddup2(&fa, sv[1], kWorkerFd);   // the copy is inherited
+        std::string fd = std::to_string(kWorkerFd), th = std::to_string(threads), cache = std::to_string(cacheBytes);
+        std::vector<char*> argv{const_cast<char*>(exe.c_str()), const_cast<char*>("--worker"), fd.data(),
+                                const_cast<char*>("--threads"), th.data(),
+                                const_cast<char*>("--cache"), cache.data(), nullptr};
+        int err = posix_spawn(&pid, exe.c_str(), &fa, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&fa);
+        close(sv[1]);
+        if (err != 0) {
+            close(sv[0]);
+            pid = -1;
+            throw std::runtime_error("Cannot start worker " + exe + ": " + std::strerror(err));
+        }
+        ch.fd = sv[0];
+        ch.buf.clear();
+    }
+    // Closing the socket ends an idle worker; `force` doesn't wait for that.
+    void stop(bool force) {
+        if (pid > 0 && force) kill(pid, SIGKILL);
+        if (ch.fd >= 0) close(ch.fd);
+        ch.fd = -1;
+        if (pid > 0) waitpid(pid, nullptr, 0);
+        pid = -1;
+    }
+};
+
+ProcessPool::ProcessPool(ProcessPoolOptions o) : options(std::move(o)), queue(64) {
+    int hw = int(std::max(1u, std::thread::hardware_concurrency()));
+    int n = options.workers > 0 ? options.workers : std::max(1, hw / 4);
+    threadsPerWorker = std::max(1, hw / n);
+    if (options.executable.empty()) options.executable = defaultExecutable();
+    for (int i = 0; i < n; i++) slots.push_back(std::make_unique<Worker>());
+    for (auto& slot : slots) dispatchers.emplace_back([this, w = slot.get()]{ dispatch(*w); });
+}
+
+ProcessPool::~ProcessPool() {
+    queue.close();
+    for (auto& t : dispatchers) t.join();
+    for (auto& w : slots) w->stop(false);
+}
+
+std::future<ProcessPool::Result> ProcessPool::submit(Job job) {
+    auto p = std::make_shared<Pending>();
+    p->job = std::move(job);
+    auto f = p->promise.get_future();
+    // Superseded jobs leave the queue now, so a burst of them can't fill it
+    // and block the caller behind workers that are still busy.
+    auto stale = [](const std::shared_ptr<Pending>& q){ return q->job.cancelled && *q->job.cancelled; };
+    for (auto& q : queue.removeIf(stale)) drop(*q);
+    if (!queue.push(p)) throw std::runtime_error("Process pool is shut down");
+    return f;
+}
+
+ProcessPool::Stats ProcessPool::stats() const {
+    return {jobs.load(), failed.load(), timeouts.load(), restarts.load(), dropped.load()};
+}
+
+// Workers start on their first job, so an unused pool costs nothing.
+void ProcessPool::dispatch(Worker& w) {
+    std::shared_ptr<Pending> p;
+    while (queue.pop(p)) {
+        // Superseded while queued, e.g. by the next step of a slider drag.
+        if (p->job.cancelled && *p->job.cancelled) {
+            drop(*p);
+            continue;
+        }
+        jobs++;
+        try {
+            p->promise.set_value(run(w, p->job));
+        } catch (...) {
+            failed++;
+            p->promise.set_exception(std::current_exception());
+        }
+        p.reset();
+    }
+}
+
+void ProcessPool::drop(Pending& p) {
+    dropped++;
+    p.promise.set_exception(std::make_exception_ptr(std::runtime_error("Job cancelled")));
+}
+
+void ProcessPool::restart(Worker& w) {
+    w.stop(true);
+    restarts++;
+    try { w.start(options.executable, threadsPerWorker, options.cacheBytes); }
+    catch (const std::exception&) {}   // tried again with the next job
+}
+
+// Pixels are copied only the first time a sourceId is seen, or again after
+// it was evicted.
+std::shared_ptr<ProcessPool::Resident> ProcessPool::share(const Input& in) {
+    std::lock_guard<std::mutex> lk(residentMutex);
+    auto it = in.sourceId ? resident.find(in.sourceId) : resident.end();
+    std::shared_ptr<Resident> r;
+    if (it != resident.end()) {
+        r = it->second;
+    } else {
+        r = std::make_shared<Resident>();
+        r->name = "/node-" + std::to_string(getpid()) + "-src-" + std::to_string(nextJob++);
+        r->desc = packFrames({in.pixels}, r->name, r->seg);
+        r->bytes = in.pixels.bytes();
+        if (in.sourceId) {
+            resident[in.sourceId] = r;
+            residentTotal += r->bytes;
+        }
+    }
+    r->inFlight++;
+    r->lastUsed = ++useClock;
+    return r;
+}
+
+// Least recently used sources go while the total is over budget; none a
+// running job names.
+void ProcessPool::release(const std::vector<std::shared_ptr<Resident>>& used) {
+    std::lock_guard<std::mutex> lk(residentMutex);
+    for (auto& r : used) r->inFlight--;
+    while (residentTotal > options.residentBytes) {
+        auto lru = resident.end();
+        for (auto it = resident.begin(); it != resident.end(); ++it)
+            if (it->second->inFlight == 0 && (lru == resident.end() || it->second->lastUsed < lru->second->lastUsed))
+                lru = it;
+        if (lru == resident.end()) break;
+        residentTotal -= lru->second->bytes;
+        resident.erase(lru);
+    }
+}
+
+ProcessPool::Result ProcessPool::run(Worker& w, const Job& job) {
+    std::string outName = "/node-" + std::to_string(getpid()) + "-" + std::to_string(nextJob++) + "-out";
+    std::vector<std::shared_ptr<Resident>> used;
+    // Whatever becomes of the worker, the output segment doesn't outlive
+    // the job, and its sources can be evicted again.
+    struct Done {
+        ProcessPool& pool;
+        const std::string& out;
+        const std::vector<std::shared_ptr<Resident>>& used;
+        ~Done() { shm_unlink(out.c_str()); pool.release(used); }
+    } done{*this, outName, used};
+
+    std::ostringstream head;
+    head << "job " << std::setprecision(17) << job.renderScale << " " << job.graph.size() << " "
+         << outName << " " << job.inputs.size();
+    for (auto& in : job.inputs) {
+        if (in.pixels.empty()) {
+            head << " - 0 0 0 0 0";
+            continue;
+        }
+        used.push_back(share(in));
+        head << " " << used.back()->name << used.back()->desc;
+    }
+    head << "\n";
+    std::string msg = head.str() + job.graph;
+
+    if (w.pid < 0) w.start(options.executable, threadsPerWorker, options.cacheBytes);
+    if (!w.ch.write(msg)) {
+        // Died while idle, before seeing this job; a fresh worker gets it.
+        restart(w);
+        if (w.pid < 0 || !w.ch.write(msg)) throw std::runtime_error("Worker " + options.executable + " won't start");
+    }
+
+    std::string line;
+    bool timedOut = false;
+    auto deadline = Clock::now() + std::chrono::milliseconds(options.timeoutMs);
+    if (!w.ch.readLine(line, deadline, timedOut)) {
+        restart(w);
+        if (!timedOut) throw std::runtime_error("Worker crashed; restarted it");
+        timeouts++;
+        throw std::runtime_error("Job timed out after " + std::to_string(options.timeoutMs) + " ms; worker restarted");
+    }
+
+    std::istringstream is(line);
+    std::string status;
+    is >> status;
+    if (status == "err") {
+        std::string what;
+        std::getline(is >> std::ws, what);
+        throw std::runtime_error(what);
+    }
+    size_t n = 0;
+    if (status != "ok" || !(is >> n)) {
+        restart(w);
+        throw std::runtime_error("Garbled reply from worker");
+    }
+    Result out(n);
+    Segment seg;
+    for (size_t i = 0; i < n; i++) {
+        Desc d;
+        if (!(is >> d)) throw std::runtime_error("Garbled reply from worker");
+        if (d.rows <= 0) continue;
+        if (!seg.data()) seg = Segment::openReadOnly(outName);
+        cv::Mat m = FramePool::mat();
+        m.create(d.rows, d.cols, d.type);
+        std::memcpy(m.data, locate(seg, d), d.bytes());
+        out[i] = Frame(m, ChannelOrder(d.order));
+    }
+    return out;
+}
+
+int runPoolWorker(int fd, int threads, size_t cacheBytes) {
+    if (threads > 0) NodeGraph::setThreadBudget(threads);
+    Channel ch{fd};
+    const auto never = Clock::time_point::max();
+    bool timedOut = false;
+    std::string line;
+    std::unique_ptr<NodeGraph> g;
+    std::vector<std::shared_ptr<InputNode>> ins;
+    std::vector<std::shared_ptr<OutputNode>> outs;
+    std::vector<std::string> sources;   // per input, the segment its pixels came from
+
+    while (ch.readLine(line, never, timedOut)) {
+        std::istringstream is(line);
+        std::string cmd, outName, text;
+        double scale = 1;
+        size_t textBytes = 0, n = 0;
+        is >> cmd >> scale >> textBytes >> outName >> n;
+        if (cmd != "job" || !ch.readExact(text, textBytes, never, timedOut)) return 1;
+
+        std::ostringstream reply;
+        try {
+            // The graph, its intermediates and its cache are kept while only
+            // parameters change, as over a slider drag or a batch.
+            auto fresh = std::make_unique<NodeGraph>();
+            loadGraphFromString(*fresh, text, true);
+            if (!g || !sameShape(*fresh, *g)) {
+                g = std::move(fresh);
+                g->resultCache().setBudget(cacheBytes);
+                ins.clear();
+                outs.clear();
+                for (Node* node : byId(*g)) {
+                    auto sp = g->nodes.at(node->id);
+                    if (auto i = std::dynamic_pointer_cast<InputNode>(sp)) ins.push_back(i);
+                    else if (auto o = std::dynamic_pointer_cast<OutputNode>(sp)) outs.push_back(o);
+                }
+                sources.assign(ins.size(), std::string());
+            } else {
+                copyChangedParams(*fresh, *g);
+            }
+            g->setRenderScale(scale);
+            for (size_t i = 0; i < n; i++) {
+                std::string name;
+                Desc d;
+                if (!(is >> name >> d)) throw std::runtime_error("Garbled job");
+                if (i >= ins.size()) throw std::runtime_error("Job has more inputs than the graph");
+                if (name == sources[i]) continue;   // same pixels as last time
+                if (name != "-") {
+                    // Copied out, so the segment can go whenever the pool likes.
+                    Segment seg = Segment::openReadOnly(name);
+                    cv::Mat m = FramePool::mat();
+                    m.create(d.rows, d.cols, d.type);
+                    std::memcpy(m.data, locate(seg, d), d.bytes());
+                    ins[i]->setImage(Frame(m, ChannelOrder(d.order)), ins[i]->path());
+                } else if (!ins[i]->path().empty()) {
+                    ins[i]->loadImage(ins[i]->path());
+                } else {
+                    ins[i]->setImage(Frame());
+                }
+                sources[i] = name;
+            }
+            g->evaluate();
+            std::vector<Frame> results;
+            for (auto& o : outs) results.push_back(o->getResult());
+            Segment out;
+            reply << "ok " << results.size() << packFrames(results, outName, out);
+        } catch (const std::exception& e) {
+            std::string what = e.what();
+            std::replace(what.begin(), what.end(), '\n', ' ');
+            reply.str("");
+            reply << "err " << what;
+        }
+        if (!ch.write(reply.str() + "\n")) return 1;
+    }
+    return 0;
+}
+
+#else
+
+struct ProcessPool::Worker {};
+
+ProcessPool::ProcessPool(ProcessPoolOptions o) : options(std::move(o)), queue(1) {
+    throw std::runtime_error("Worker processes need a POSIX system");
+}
+ProcessPool::~ProcessPool() = default;
+std::future<ProcessPool::Result> ProcessPool::submit(Job) { throw std::runtime_error("Worker processes need a POSIX system"); }
+ProcessPool::Stats ProcessPool::stats() const { return {}; }
+void ProcessPool::dispatch(Worker&) {}
+void ProcessPool::restart(Worker&) {}
+void ProcessPool::drop(Pending&) {}
+ProcessPool::Result ProcessPool::run(Worker&, const Job&) { return {}; }
+std::shared_ptr<ProcessPool::Resident> ProcessPool::share(const Input&) { return nullptr; }
+void ProcessPool::release(const std::vector<std::shared_ptr<Resident>>&) {}
+int runPoolWorker(int, int, size_t) { return 1; }
+
+#endif
@@ -0,0 +1,97 @@
+// ----------------- process_pool.h -----------------
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "bounded_queue.h"
+#include "frame.h"
+
+struct ProcessPoolOptions {
+    int workers = 0;            // processes; 0 picks one per four cores
+    int timeoutMs = 120000;     // per job, from dispatch to reply
+    size_t residentBytes = size_t(1) << 30;   // source images kept shared between jobs
+    size_t cacheBytes = size_t(256) << 20;    // each worker's result cache; 0 for one-off inputs
+    // Run as `<executable> --worker <fd> --threads <n> --cache <bytes>`;
+    // empty means the node_batch next to the running program.
+    std::string executable;
+};
+
+// Evaluates graphs in a pool of local worker processes, so a crash or a
+// runaway node costs one job instead of the session, and each process has
+// its own allocator and OpenCV threads. Frames are never serialized: each
+// source image is copied once into a POSIX shared memory segment that
+// stays resident, keyed by its sourceId, for as long as jobs use it; each
+// job gets one more segment for its outputs, and the graph itself goes
+// over a socket as text. Workers keep their graph and cache between jobs
+// and apply only the parameters that changed, so an edit reruns only the
+// nodes it touches. Jobs wait in
+// one queue that every worker's dispatcher pulls from, so an idle worker
+// always takes the next job. A worker that crashes or overruns its timeout
+// is killed and restarted, and only its job fails. POSIX only.
+class ProcessPool {
+public:
+    struct Input {
+        Frame pixels;                   // empty: the worker loads the node's path
+        uint64_t sourceId = 0;          // InputNode::sourceId(); 0: shared for this job only
+    };
+    struct Job {
+        std::string graph;              // graphToString() text
+        double renderScale = 1.0;
+        std::vector<Input> inputs;      // per input node in id order
+        // Set to drop the job if no worker has taken it yet; its future
+        // then throws. A job already running finishes.
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+    using Result = std::vector<Frame>;  // per output node in id order
+
+    struct Stats {
+        uint64_t jobs = 0, failed = 0, timeouts = 0, restarts = 0, dropped = 0;
+    };
+
+    explicit ProcessPool(ProcessPoolOptions options = {});
+    ~ProcessPool();
+    ProcessPool(const ProcessPool&) = delete;
+    ProcessPool& operator=(const ProcessPool&) = delete;
+
+    // get() throws if the job failed, timed out or its worker crashed.
+    std::future<Result> submit(Job job);
+    int workers() const { return int(slots.size()); }
+    Stats stats() const;
+
+private:
+    struct Worker;
+    struct Resident;
+    struct Pending {
+        Job job;
+        std::promise<Result> promise;
+    };
+    void dispatch(Worker& w);
+    Result run(Worker& w, const Job& job);
+    void restart(Worker& w);
+    void drop(Pending& p);
+    std::shared_ptr<Resident> share(const Input& in);
+    void release(const std::vector<std::shared_ptr<Resident>>& used);
+
+    ProcessPoolOptions options;
+    int threadsPerWorker = 1;
+    BoundedQueue<std::shared_ptr<Pending>> queue;
+    std::vector<std::unique_ptr<Worker>> slots;
+    std::vector<std::thread> dispatchers;
+    std::mutex residentMutex;
+    std::unordered_map<uint64_t, std::shared_ptr<Resident>> resident;   // by sourceId
+    size_t residentTotal = 0;
+    uint64_t useClock = 0;
+    std::atomic<uint64_t> nextJob{0};
+    std::atomic<uint64_t> jobs{0}, failed{0}, timeouts{0}, restarts{0}, dropped{0};
+};
+
+// Worker side: serves jobs arriving on the socket `fd` until it closes,
+// with at most `threads` threads per evaluation (0: no limit) and a result
+// cache of `cacheBytes`. Returns the process exit code.
+int runPoolWorker(int fd, int threads, size_t cacheBytes);
@@ -0,0 +1,112 @@
+#include "profiler.h"
+#include <algorithm>
+#include <fstream>
+
+const char* toString(RunStatus s) {
+    switch (s) {
+    case RunStatus::Computed:  return "computed";
+    case RunStatus::Cached:    return "cached";
+    case RunStatus::Fused:     return "fused";
+    case RunStatus::Clean:     return "clean";
+    case RunStatus::Cancelled: return "cancelled";
+    }
+    return "";
+}
+
+void Profiler::setHistory(size_t n) {
+    std::lock_guard<std::mutex> lk(m);
+    historyLimit = std::max<size_t>(1, n);
+    while (history.size() > historyLimit) history.pop_front();
+}
+
+void Profiler::beginEvaluation() {
+    if (!enabled) return;
+    std::lock_guard<std::mutex> lk(m);
+    current = EvalProfile();
+    current.index = ++evaluations;
+    // Nodes the evaluation doesn't visit were clean.
+    for (auto& kv : stats) kv.second.lastStatus = RunStatus::Clean;
+    current.startUs = now();
+}
+
+void Profiler::record(NodeSample s) {
+    if (!enabled) return;
+    std::lock_guard<std::mutex> lk(m);
+    auto id = std::this_thread::get_id();
+    auto it = threadIndex.find(id);
+    if (it == threadIndex.end()) it = threadIndex.emplace(id, int(threadIndex.size())).first;
+    s.thread = it->second;
+    NodeStat& st = stats[s.nodeId];
+    st.lastStatus = s.status;
+    if (s.status == RunStatus::Computed) st.lastComputedMs = s.durUs / 1e3;
+    current.nodes.push_back(std::move(s));
+}
+
+void Profiler::endEvaluation(bool completed, uint64_t copies, uint64_t bytesCopied) {
+    if (!enabled) return;
+    std::lock_guard<std::mutex> lk(m);
+    current.durUs = now() - current.startUs;
+    current.completed = completed;
+    current.copies = copies;
+    current.bytesCopied = bytesCopied;
+    history.push_back(std::move(current));
+    while (history.size() > historyLimit) history.pop_front();
+    current = EvalProfile();
+}
+
+EvalProfile Profiler::last() const {
+    std::lock_guard<std::mutex> lk(m);
+    return history.empty() ? EvalProfile() : history.back();
+}
+
+std::unordered_map<int, Profiler::NodeStat> Profiler::nodeStats() const {
+    std::lock_guard<std::mutex> lk(m);
+    return stats;
+}
+
+namespace {
+
+std::string escape(const std::string& s) {
+    std::string r;
+    for (char c : s) {
+        if (c == '"' || c == '\\') r += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        r += c;
+    }
+    return r;
+}
+
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const {
+    std::lock_guard<std::mutex> lk(m);
+    std::ofstream f(path);
+    if (!f) return false;
+    f << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    auto sep = [&]{ f << (first ? "  " : ",\n  "); first = false; };
+    sep();
+    f << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": -1, \"args\": {\"name\": \"evaluations\"}}";
+    for (auto& kv : threadIndex) {
+        sep();
+        f << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << kv.second
+          << ", \"args\": {\"name\": \"thread " << kv.second << "\"}}";
+    }
+    for (auto& e : history) {
+        // The evaluation spans its own track so node slices never overlap it.
+        sep();
+        f << "{\"name\": \"evaluate #" << e.index << "\", \"cat\": \"graph\", \"ph\": \"X\""
+          << ", \"pid\": 1, \"tid\": -1, \"ts\": " << e.startUs << ", \"dur\": " << e.durUs
+          << ", \"args\": {\"completed\": " << (e.completed ? "true" : "false") << "}}";
+        for (auto& s : e.nodes) {
+            sep();
+            f << "{\"name\": \"" << escape(s.name) << "\", \"cat\": \"" << toString(s.status)
+              << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << s.thread
+              << ", \"ts\": " << s.startUs << ", \"dur\": " << s.durUs
+              << ", \"args\": {\"id\": " << s.nodeId << ", \"status\": \"" << toString(s.status)
+              << "\", \"bytes\": " << s.bytes << ", \"evaluation\": " << e.index << "}}";
+        }
+    }
+    f << "\n]}\n";
+    return bool(f);
+}
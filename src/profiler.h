@@ -0,0 +1,79 @@
+// ----------------- profiler.h -----------------
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// What an evaluation did with a node.
+enum class RunStatus {
+    Computed,   // process() ran (for a fused chain, the tail did the whole chain)
+    Cached,     // served from the result cache
+    Fused,      // computed by a downstream node's fused pass
+    Clean,      // not dirty; skipped
+    Cancelled,  // dirty but not started because the evaluation was cancelled
+};
+const char* toString(RunStatus s);
+
+struct NodeSample {
+    int nodeId = -1;
+    std::string name;
+    RunStatus status = RunStatus::Clean;
+    double startUs = 0, durUs = 0;   // since the profiler was created
+    size_t bytes = 0;                // output allocated by this run
+    int thread = 0;
+};
+
+struct EvalProfile {
+    uint64_t index = 0;
+    double startUs = 0, durUs = 0;
+    bool completed = false;
+    uint64_t copies = 0, bytesCopied = 0;   // full-frame copies made by its nodes
+    std::vector<NodeSample> nodes;
+};
+
+// Per-node timings for each evaluation, kept for the last few evaluations.
+// Recording is thread-safe; readers get copies.
+class Profiler {
+public:
+    // Latest known state of one node, for overlays.
+    struct NodeStat {
+        double lastComputedMs = -1;      // wall time of the most recent real run
+        RunStatus lastStatus = RunStatus::Clean;
+    };
+
+    Profiler() : epoch(std::chrono::steady_clock::now()) {}
+
+    void setEnabled(bool on) { enabled = on; }
+    bool isEnabled() const { return enabled; }
+    void setHistory(size_t evaluations);
+
+    double now() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void beginEvaluation();
+    void record(NodeSample s);
+    void endEvaluation(bool completed, uint64_t copies = 0, uint64_t bytesCopied = 0);
+
+    EvalProfile last() const;
+    std::unordered_map<int, NodeStat> nodeStats() const;
+    // Every kept evaluation as a Chrome/Perfetto trace ("traceEvents" JSON).
+    bool writeChromeTrace(const std::string& path) const;
+
+private:
+    std::atomic<bool> enabled{true};
+    std::chrono::steady_clock::time_point epoch;
+    mutable std::mutex m;
+    EvalProfile current;
+    std::deque<EvalProfile> history;
+    size_t historyLimit = 32;
+    uint64_t evaluations = 0;
+    std::unordered_map<int, NodeStat> stats;
+    std::unordered_map<std::thread::id, int> threadIndex;
+};
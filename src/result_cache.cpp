@@ -0,0 +1,70 @@
+#include "result_cache.h"
+#include "node_framework.h"
+
+uint64_t nodeFingerprint(const Node& node) {
+    Fingerprint f;
+    f.add(node.typeName());
+    for (auto& p : node.paramNames()) f.add(node.getParam(p));
+    f.add(node.getRenderScale());
+    f.add(node.sourceId());
+    for (auto& port : node.inputs)
+        for (auto& c : port.connections) {
+            f.add(c.node->fingerprint);
+            f.add(uint64_t(c.portIndex));
+        }
+    return f.h;
+}
+
+bool ResultCache::lookup(uint64_t key, Frame& out) {
+    std::lock_guard<std::mutex> lk(m);
+    auto it = entries.find(key);
+    if (it == entries.end()) { misses++; return false; }
+    recent.splice(recent.begin(), recent, it->second.lru);
+    out = it->second.frame;
+    hits++;
+    return true;
+}
+
+void ResultCache::insert(uint64_t key, const Frame& frame) {
+    if (frame.empty() || frame.bytes() > budget) return;
+    std::lock_guard<std::mutex> lk(m);
+    if (entries.count(key)) return;
+    recent.push_front(key);
+    entries[key] = Entry{frame, recent.begin()};
+    bytes += frame.bytes();
+    evictToFit();
+}
+
+void ResultCache::setBudget(size_t b) {
+    std::lock_guard<std::mutex> lk(m);
+    budget = b;
+    evictToFit();
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lk(m);
+    entries.clear();
+    recent.clear();
+    bytes = 0;
+}
+
+ResultCache::Stats ResultCache::stats() const {
+    std::lock_guard<std::mutex> lk(m);
+    Stats s;
+    s.hits = hits;
+    s.misses = misses;
+    s.evictions = evictions;
+    s.bytes = bytes;
+    s.entries = entries.size();
+    return s;
+}
+
+void ResultCache::evictToFit() {
+    while (bytes > budget && !recent.empty()) {
+        auto it = entries.find(recent.back());
+        bytes -= it->second.frame.bytes();
+        entries.erase(it);
+        recent.pop_back();
+        evictions++;
+    }
+}
@@ -0,0 +1,54 @@
+// ----------------- result_cache.h -----------------
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "frame.h"
+
+class Node;
+
+// FNV-1a over whatever identifies a result.
+struct Fingerprint {
+    uint64_t h = 1469598103934665603ull;
+    void add(const void* data, size_t n) {
+        auto* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < n; i++) { h ^= p[i]; h *= 1099511628211ull; }
+    }
+    void add(const std::string& s) { add(s.data(), s.size()); }
+    void add(double v) { add(&v, sizeof v); }
+    void add(uint64_t v) { add(&v, sizeof v); }
+};
+
+// Key for a node's output: type, parameter values, render scale, source
+// identity and the keys of everything upstream. Equal keys mean equal
+// pixels, so a hit can be shared without copying.
+uint64_t nodeFingerprint(const Node& node);
+
+// Content-addressed store of node outputs with LRU eviction under a byte
+// budget. Frames are shared, never copied, on insert and lookup.
+class ResultCache {
+public:
+    struct Stats { uint64_t hits = 0, misses = 0, evictions = 0; size_t bytes = 0, entries = 0; };
+
+    explicit ResultCache(size_t budgetBytes = size_t(512) << 20) : budget(budgetBytes) {}
+
+    bool lookup(uint64_t key, Frame& out);
+    void insert(uint64_t key, const Frame& frame);
+    void setBudget(size_t bytes);
+    size_t getBudget() const { return budget; }
+    void clear();
+    Stats stats() const;
+
+private:
+    void evictToFit();
+
+    struct Entry { Frame frame; std::list<uint64_t>::iterator lru; };
+    mutable std::mutex m;
+    std::unordered_map<uint64_t, Entry> entries;
+    std::list<uint64_t> recent;   // most recently used first
+    size_t budget, bytes = 0;
+    uint64_t hits = 0, misses = 0, evictions = 0;
+};
@@ -0,0 +1,58 @@
+#include "simd_kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include "simd_x86.h"
+
+namespace simd {
+
+namespace {
+
+using namespace x86;
+
+// 32 samples per step. The 256-bit packs work per 128-bit lane, so the
+// packed dwords come out as 0,2,4,6,1,3,5,7 and need one permute.
+inline __m256i pack(__m256 f0, __m256 f1, __m256 f2, __m256 f3) {
+    __m256i lo = _mm256_packs_epi32(_mm256_cvtps_epi32(f0), _mm256_cvtps_epi32(f1));
+    __m256i hi = _mm256_packs_epi32(_mm256_cvtps_epi32(f2), _mm256_cvtps_epi32(f3));
+    __m256i b = _mm256_packus_epi16(lo, hi);
+    return _mm256_permutevar8x32_epi32(b, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+inline __m256 widen(const uint8_t* p) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+void affineRow(const uint8_t* s, uint8_t* d, int n, float alpha, float beta) {
+    const __m256 va = _mm256_set1_ps(alpha), vb = _mm256_set1_ps(beta);
+    int x = 0;
+    for (; x + 32 <= n; x += 32) {
+        __m256 f[4];
+        for (int k = 0; k < 4; k++) f[k] = _mm256_add_ps(_mm256_mul_ps(widen(s + x + 8*k), va), vb);
+        _mm256_storeu_si256((__m256i*)(d + x), pack(f[0], f[1], f[2], f[3]));
+    }
+    affineTail(s, d, x, n, alpha, beta);
+}
+
+inline __m256 loadAcc(const float* a) { return _mm256_loadu_ps(a); }
+inline __m256 loadAcc(const int32_t* a) { return _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)a)); }
+
+template <typename T>
+void mixRow(const T* a, const uint8_t* s, uint8_t* d, int n, float scale, float keep) {
+    const __m256 vs = _mm256_set1_ps(scale), vk = _mm256_set1_ps(keep);
+    int x = 0;
+    for (; x + 32 <= n; x += 32) {
+        __m256 f[4];
+        for (int k = 0; k < 4; k++)
+            f[k] = _mm256_add_ps(_mm256_mul_ps(loadAcc(a + x + 8*k), vs),
+                                 _mm256_mul_ps(widen(s + x + 8*k), vk));
+        _mm256_storeu_si256((__m256i*)(d + x), pack(f[0], f[1], f[2], f[3]));
+    }
+    mixTail(a, s, d, x, n, scale, keep);
+}
+
+}
+
+const detail::Kernels detail::avx2 = {affineRow, mixRow<float>, mixRow<int32_t>};
+
+}
+#endif
@@ -0,0 +1,51 @@
+#include "simd_kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include "simd_x86.h"
+
+namespace simd {
+
+namespace {
+
+using namespace x86;
+
+// 16 samples per vector, four vectors per step. Negative values are
+// clamped first because the narrowing store saturates as unsigned.
+inline void store(uint8_t* d, __m512 f) {
+    __m512i i = _mm512_max_epi32(_mm512_cvtps_epi32(f), _mm512_setzero_si512());
+    _mm_storeu_si128((__m128i*)d, _mm512_cvtusepi32_epi8(i));
+}
+
+inline __m512 widen(const uint8_t* p) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)p)));
+}
+
+void affineRow(const uint8_t* s, uint8_t* d, int n, float alpha, float beta) {
+    const __m512 va = _mm512_set1_ps(alpha), vb = _mm512_set1_ps(beta);
+    int x = 0;
+    for (; x + 64 <= n; x += 64)
+        for (int k = 0; k < 64; k += 16)
+            store(d + x + k, _mm512_add_ps(_mm512_mul_ps(widen(s + x + k), va), vb));
+    affineTail(s, d, x, n, alpha, beta);
+}
+
+inline __m512 loadAcc(const float* a) { return _mm512_loadu_ps(a); }
+inline __m512 loadAcc(const int32_t* a) { return _mm512_cvtepi32_ps(_mm512_loadu_si512(a)); }
+
+template <typename T>
+void mixRow(const T* a, const uint8_t* s, uint8_t* d, int n, float scale, float keep) {
+    const __m512 vs = _mm512_set1_ps(scale), vk = _mm512_set1_ps(keep);
+    int x = 0;
+    for (; x + 64 <= n; x += 64)
+        for (int k = 0; k < 64; k += 16)
+            store(d + x + k, _mm512_add_ps(_mm512_mul_ps(loadAcc(a + x + k), vs),
+                                           _mm512_mul_ps(widen(s + x + k), vk)));
+    mixTail(a, s, d, x, n, scale, keep);
+}
+
+}
+
+const detail::Kernels detail::avx512 = {affineRow, mixRow<float>, mixRow<int32_t>};
+
+}
+#endif
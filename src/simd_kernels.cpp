@@ -0,0 +1,131 @@
+#include "simd_kernels.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NODE_SIMD_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+namespace simd {
+
+namespace {
+
+void affineScalar(const uint8_t* s, uint8_t* d, int n, float alpha, float beta) {
+    for (int x = 0; x < n; x++) d[x] = cv::saturate_cast<uchar>(s[x]*alpha + beta);
+}
+
+void mixScalarF(const float* a, const uint8_t* s, uint8_t* d, int n, float scale, float keep) {
+    for (int x = 0; x < n; x++) d[x] = cv::saturate_cast<uchar>(a[x]*scale + s[x]*keep);
+}
+
+void mixScalarI(const int32_t* a, const uint8_t* s, uint8_t* d, int n, float scale, float keep) {
+    for (int x = 0; x < n; x++) d[x] = cv::saturate_cast<uchar>(a[x]*scale + s[x]*keep);
+}
+
+const detail::Kernels scalar = {affineScalar, mixScalarF, mixScalarI};
+
+Isa probe() {
+#if NODE_SIMD_X86
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 0);
+    int maxLeaf = r[0];
+    __cpuid(r, 1);
+    bool sse42 = r[2] & (1 << 20);
+    bool osxsave = r[2] & (1 << 27);
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool ymm = (xcr0 & 0x6) == 0x6, zmm = (xcr0 & 0xe6) == 0xe6;
+    bool avx2 = false, avx512 = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(r, 7, 0);
+        avx2 = ymm && (r[1] & (1 << 5));
+        avx512 = zmm && (r[1] & (1 << 16));
+    }
+#else
+    __builtin_cpu_init();
+    bool sse42 = __builtin_cpu_supports("sse4.2");
+    bool avx2 = __builtin_cpu_supports("avx2");
+    bool avx512 = __builtin_cpu_supports("avx512f");
+#endif
+    Isa best = avx512 ? Isa::AVX512 : avx2 ? Isa::AVX2 : sse42 ? Isa::SSE42 : Isa::Scalar;
+    if (const char* env = std::getenv("NODE_SIMD")) {
+        for (Isa cap : {Isa::Scalar, Isa::SSE42, Isa::AVX2, Isa::AVX512})
+            if (!std::strcmp(env, name(cap)) && cap < best) best = cap;
+    }
+    return best;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+const detail::Kernels& kernelsFor(Isa isa) {
+#if NODE_SIMD_X86
+    switch (isa) {
+    case Isa::AVX512: return detail::avx512;
+    case Isa::AVX2:   return detail::avx2;
+    case Isa::SSE42:  return detail::sse42;
+    case Isa::Scalar: break;
+    }
+#endif
+    return scalar;
+}
+
+std::atomic<const detail::Kernels*> current{nullptr};
+std::atomic<Isa> currentIsa{Isa::Scalar};
+
+const detail::Kernels& kernels() {
+    const detail::Kernels* k = current.load(std::memory_order_acquire);
+    if (!k) {
+        setActive(detected());
+        k = current.load(std::memory_order_acquire);
+    }
+    return *k;
+}
+
+}
+
+Isa detected() {
+    static const Isa best = probe();
+    return best;
+}
+
+Isa active() {
+    kernels();
+    return currentIsa;
+}
+
+void setActive(Isa isa) {
+    if (isa > detected()) isa = detected();
+    currentIsa = isa;
+    current.store(&kernelsFor(isa), std::memory_order_release);
+}
+
+const char* name(Isa isa) {
+    switch (isa) {
+    case Isa::Scalar: return "scalar";
+    case Isa::SSE42:  return "sse4.2";
+    case Isa::AVX2:   return "avx2";
+    case Isa::AVX512: return "avx512";
+    }
+    return "";
+}
+
+void affine(const uint8_t* s, uint8_t* d, int n, float alpha, float beta) {
+    kernels().affine(s, d, n, alpha, beta);
+}
+
+void mix(const float* acc, const uint8_t* s, uint8_t* d, int n, float scale, float keep) {
+    kernels().mixF(acc, s, d, n, scale, keep);
+}
+
+void mix(const int32_t* acc, const uint8_t* s, uint8_t* d, int n, float scale, float keep) {
+    kernels().mixI(acc, s, d, n, scale, keep);
+}
+
+}
@@ -0,0 +1,41 @@
+// ----------------- simd_kernels.h -----------------
+#pragma once
+#include <cstdint>
+
+// Hand-vectorised row kernels for the 8-bit hot loops, with the
+// implementation picked once at runtime from what the CPU supports. Every
+// variant does the same float multiply and add in the same order (never
+// fused) and rounds half to even like cv::saturate_cast, so output is
+// bit-exact with the scalar path whichever one runs.
+//
+// Rows are plain interleaved samples: pass cols * channels as n.
+namespace simd {
+
+enum class Isa { Scalar, SSE42, AVX2, AVX512 };
+
+// Best variant this CPU and build support. NODE_SIMD=scalar|sse4.2|avx2|avx512
+// in the environment caps it.
+Isa detected();
+Isa active();
+// Selects a variant, e.g. to benchmark them side by side; clamped to detected().
+void setActive(Isa isa);
+const char* name(Isa isa);
+
+// d = saturate(s*alpha + beta)
+void affine(const uint8_t* s, uint8_t* d, int n, float alpha, float beta);
+// d = saturate(acc*scale + s*keep); the blur+amount mix with acc the
+// unnormalised blur.
+void mix(const float* acc, const uint8_t* s, uint8_t* d, int n, float scale, float keep);
+void mix(const int32_t* acc, const uint8_t* s, uint8_t* d, int n, float scale, float keep);
+
+namespace detail {
+struct Kernels {
+    void (*affine)(const uint8_t*, uint8_t*, int, float, float);
+    void (*mixF)(const float*, const uint8_t*, uint8_t*, int, float, float);
+    void (*mixI)(const int32_t*, const uint8_t*, uint8_t*, int, float, float);
+};
+// Defined in simd_<isa>.cpp; only present on x86 builds.
+extern const Kernels sse42, avx2, avx512;
+}
+
+}
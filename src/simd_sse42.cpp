@@ -0,0 +1,62 @@
+#include "simd_kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include "simd_x86.h"
+
+namespace simd {
+
+namespace {
+
+using namespace x86;
+
+// 16 samples per step: widen to four float vectors, compute, round and
+// pack back down with saturation.
+inline __m128i pack(__m128 f0, __m128 f1, __m128 f2, __m128 f3) {
+    __m128i lo = _mm_packs_epi32(_mm_cvtps_epi32(f0), _mm_cvtps_epi32(f1));
+    __m128i hi = _mm_packs_epi32(_mm_cvtps_epi32(f2), _mm_cvtps_epi32(f3));
+    return _mm_packus_epi16(lo, hi);
+}
+
+template <int K>
+inline __m128 widen(__m128i v) {
+    return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4*K)));
+}
+
+void affineRow(const uint8_t* s, uint8_t* d, int n, float alpha, float beta) {
+    const __m128 va = _mm_set1_ps(alpha), vb = _mm_set1_ps(beta);
+    int x = 0;
+    for (; x + 16 <= n; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + x));
+        __m128 f0 = _mm_add_ps(_mm_mul_ps(widen<0>(v), va), vb);
+        __m128 f1 = _mm_add_ps(_mm_mul_ps(widen<1>(v), va), vb);
+        __m128 f2 = _mm_add_ps(_mm_mul_ps(widen<2>(v), va), vb);
+        __m128 f3 = _mm_add_ps(_mm_mul_ps(widen<3>(v), va), vb);
+        _mm_storeu_si128((__m128i*)(d + x), pack(f0, f1, f2, f3));
+    }
+    affineTail(s, d, x, n, alpha, beta);
+}
+
+inline __m128 loadAcc(const float* a) { return _mm_loadu_ps(a); }
+inline __m128 loadAcc(const int32_t* a) { return _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)a)); }
+
+template <typename T>
+void mixRow(const T* a, const uint8_t* s, uint8_t* d, int n, float scale, float keep) {
+    const __m128 vs = _mm_set1_ps(scale), vk = _mm_set1_ps(keep);
+    int x = 0;
+    for (; x + 16 <= n; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + x));
+        __m128 f0 = _mm_add_ps(_mm_mul_ps(loadAcc(a + x),      vs), _mm_mul_ps(widen<0>(v), vk));
+        __m128 f1 = _mm_add_ps(_mm_mul_ps(loadAcc(a + x + 4),  vs), _mm_mul_ps(widen<1>(v), vk));
+        __m128 f2 = _mm_add_ps(_mm_mul_ps(loadAcc(a + x + 8),  vs), _mm_mul_ps(widen<2>(v), vk));
+        __m128 f3 = _mm_add_ps(_mm_mul_ps(loadAcc(a + x + 12), vs), _mm_mul_ps(widen<3>(v), vk));
+        _mm_storeu_si128((__m128i*)(d + x), pack(f0, f1, f2, f3));
+    }
+    mixTail(a, s, d, x, n, scale, keep);
+}
+
+}
+
+const detail::Kernels detail::sse42 = {affineRow, mixRow<float>, mixRow<int32_t>};
+
+}
+#endif
@@ -0,0 +1,27 @@
+// ----------------- simd_x86.h -----------------
+#pragma once
+// Shared by the simd_<isa>.cpp files only. Each of those is built with its
+// own ISA flags, so nothing here may be used from ordinary sources.
+#include <cstdint>
+#include <immintrin.h>
+
+namespace simd {
+namespace x86 {
+
+// cv::saturate_cast<uchar>(float): round half to even, then clamp.
+static inline uint8_t sat(float v) {
+    int i = _mm_cvtss_si32(_mm_set_ss(v));
+    return uint8_t(i < 0 ? 0 : i > 255 ? 255 : i);
+}
+
+static inline void affineTail(const uint8_t* s, uint8_t* d, int x, int n, float alpha, float beta) {
+    for (; x < n; x++) d[x] = sat(s[x]*alpha + beta);
+}
+
+template <typename T>
+static inline void mixTail(const T* a, const uint8_t* s, uint8_t* d, int x, int n, float scale, float keep) {
+    for (; x < n; x++) d[x] = sat(a[x]*scale + s[x]*keep);
+}
+
+}
+}
@@ -0,0 +1,88 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace {
+thread_local ThreadPool* currentPool = nullptr;
+thread_local unsigned currentIndex = 0;
+}
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threads; i++) queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < threads; i++) workers.emplace_back([this, i]{ workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::submit(Task task) {
+    // Workers push onto their own deque (keeps a branch on one core);
+    // outside threads spread work round-robin.
+    unsigned q = currentPool == this ? currentIndex : nextQueue++ % size();
+    {
+        std::lock_guard<std::mutex> lk(sleepMutex);
+        pending++;
+    }
+    {
+        std::lock_guard<std::mutex> lk(queues[q]->m);
+        queues[q]->tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::pop(unsigned index, Task& out) {
+    auto& q = *queues[index];
+    std::lock_guard<std::mutex> lk(q.m);
+    if (q.tasks.empty()) return false;
+    out = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(unsigned thief, Task& out) {
+    for (unsigned k = 1; k <= size(); k++) {
+        auto& q = *queues[(thief + k) % size()];
+        std::lock_guard<std::mutex> lk(q.m);
+        if (q.tasks.empty()) continue;
+        out = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::tryRunOne() {
+    Task task;
+    unsigned self = currentPool == this ? currentIndex : 0;
+    if (!(currentPool == this && pop(self, task)) && !steal(self, task)) return false;
+    pending--;
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    currentPool = this;
+    currentIndex = index;
+    for (;;) {
+        Task task;
+        if (pop(index, task) || steal(index, task)) {
+            pending--;
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(sleepMutex);
+        wake.wait(lk, [this]{ return stopping || pending > 0; });
+        if (stopping && pending == 0) return;
+    }
+}
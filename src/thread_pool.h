@@ -0,0 +1,45 @@
+// ----------------- thread_pool.h -----------------
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: each worker owns a deque, pops its own work LIFO and
+// steals from the front of the others when it runs dry.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(Task task);
+    // Runs one queued task on the calling thread, so waiters help instead of
+    // blocking a worker. Returns false if nothing was queued.
+    bool tryRunOne();
+    unsigned size() const { return unsigned(workers.size()); }
+
+    static ThreadPool& instance();
+
+private:
+    struct Queue { std::mutex m; std::deque<Task> tasks; };
+
+    void workerLoop(unsigned index);
+    bool pop(unsigned index, Task& out);
+    bool steal(unsigned thief, Task& out);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> pending{0};
+    std::atomic<unsigned> nextQueue{0};
+    bool stopping = false;
+};
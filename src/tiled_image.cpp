@@ -0,0 +1,321 @@
+#include "tiled_image.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef NODE_HAVE_TIFF
+#include <tiffio.h>
+#endif
+
+namespace {
+
+constexpr int kMaxLevels = 16;
+
+// Little-endian on disk, as on every platform we build for.
+struct NtfHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t type;          // OpenCV type, e.g. CV_8UC3
+    uint32_t order;         // ChannelOrder
+    uint32_t tileSize;
+    uint32_t levels;
+    uint64_t levelOffset[kMaxLevels];
+};
+
+cv::Size levelSize(cv::Size s, int k) {
+    for (int i = 0; i < k; i++) s = cv::Size((s.width + 1) / 2, (s.height + 1) / 2);   // as pyrDown
+    return s;
+}
+
+std::string lowerExtension(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return char(std::tolower(c)); });
+    return ext;
+}
+
+// Copies the part of `rect` that falls in one stored tile. The tile holds
+// `tile` of the image with rows `tileStride` bytes apart.
+void copyFromTile(const uchar* src, size_t tileStride, const cv::Rect& tile,
+                  const cv::Rect& rect, cv::Mat& out) {
+    cv::Rect r = tile & rect;
+    size_t es = out.elemSize(), n = size_t(r.width) * es;
+    for (int y = r.y; y < r.y + r.height; y++)
+        std::memcpy(out.ptr(y - rect.y) + size_t(r.x - rect.x) * es,
+                    src + size_t(y - tile.y) * tileStride + size_t(r.x - tile.x) * es, n);
+}
+
+// Read-only view of a whole file; pages load on first touch.
+class FileMapping {
+public:
+    explicit FileMapping(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open " + path);
+        LARGE_INTEGER sz;
+        GetFileSizeEx(file, &sz);
+        len = size_t(sz.QuadPart);
+        map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        base = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!base) { if (map) CloseHandle(map); CloseHandle(file); throw std::runtime_error("Cannot map " + path); }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) { ::close(fd); throw std::runtime_error("Cannot stat " + path); }
+        len = size_t(st.st_size);
+        base = len ? mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (base == MAP_FAILED) throw std::runtime_error("Cannot map " + path);
+#endif
+    }
+    ~FileMapping() {
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(map);
+        CloseHandle(file);
+#else
+        munmap(base, len);
+#endif
+    }
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    const uchar* data() const { return static_cast<const uchar*>(base); }
+    size_t size() const { return len; }
+
+private:
+    void* base = nullptr;
+    size_t len = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE, map = nullptr;
+#endif
+};
+
+class MappedImage : public TiledImage {
+public:
+    explicit MappedImage(const std::string& path) : file(path) {
+        if (file.size() < sizeof(NtfHeader)) throw std::runtime_error(path + " is not a tiled image");
+        std::memcpy(&h, file.data(), sizeof h);
+        if (std::memcmp(h.magic, "NTF1", 4) != 0 || h.version != 1)
+            throw std::runtime_error(path + " is not a tiled image");
+        if (h.levels < 1 || h.levels > kMaxLevels || h.tileSize < 1 || h.width < 1 || h.height < 1)
+            throw std::runtime_error(path + " has a damaged header");
+        es = CV_ELEM_SIZE(int(h.type));
+        for (int k = 0; k < int(h.levels); k++) {
+            cv::Size s = size(k);
+            size_t tiles = size_t(tilesAcross(s.width)) * tilesAcross(s.height);
+            if (h.levelOffset[k] + tiles * tileBytes() > file.size())
+                throw std::runtime_error(path + " is truncated");
+        }
+    }
+
+    cv::Size size(int level) const override { return levelSize(cv::Size(h.width, h.height), level); }
+    int levels() const override { return int(h.levels); }
+    int type() const override { return int(h.type); }
+    ChannelOrder order() const override { return ChannelOrder(h.order); }
+
+    void read(const cv::Rect& rect, cv::Mat& out, int level) const override {
+        level = std::clamp(level, 0, levels() - 1);
+        cv::Size s = size(level);
+        cv::Rect r = rect & cv::Rect(cv::Point(0,0), s);
+        out.create(r.size(), type());
+        if (r.empty()) return;
+        int ts = int(h.tileSize), across = tilesAcross(s.width);
+        const uchar* base = file.data() + h.levelOffset[level];
+        for (int ty = r.y / ts; ty * ts < r.y + r.height; ty++)
+            for (int tx = r.x / ts; tx * ts < r.x + r.width; tx++) {
+                const uchar* tile = base + (size_t(ty) * across + tx) * tileBytes();
+                copyFromTile(tile, size_t(ts) * es, cv::Rect(tx*ts, ty*ts, ts, ts), r, out);
+            }
+    }
+
+private:
+    int tilesAcross(int n) const { return (n + int(h.tileSize) - 1) / int(h.tileSize); }
+    size_t tileBytes() const { return size_t(h.tileSize) * h.tileSize * es; }
+
+    FileMapping file;
+    NtfHeader h;
+    size_t es = 1;
+};
+
+#ifdef NODE_HAVE_TIFF
+// Tiled, chunky 8/16-bit TIFF read through libtiff one tile at a time.
+// Reduced-resolution copies stored in the file, as SubIFDs or as following
+// directories, become levels 1 and up as long as each halves the one before.
+class TiffImage : public TiledImage {
+public:
+    static std::shared_ptr<TiledImage> open(const std::string& path) {
+        TIFF* tif = TIFFOpen(path.c_str(), "r");
+        if (!tif) return nullptr;
+        std::vector<Level> lv(1);
+        int type = -1;
+        if (!readLevel(tif, lv[0], type)) { TIFFClose(tif); return nullptr; }
+
+        std::vector<uint64_t> dirs;
+        uint16_t nSub = 0;
+        uint64_t* sub = nullptr;
+        if (TIFFGetField(tif, TIFFTAG_SUBIFD, &nSub, &sub) && nSub > 0) {
+            dirs.assign(sub, sub + nSub);
+        } else {
+            while (TIFFReadDirectory(tif)) {
+                uint32_t kind = 0;
+                TIFFGetFieldDefaulted(tif, TIFFTAG_SUBFILETYPE, &kind);
+                if (kind & FILETYPE_REDUCEDIMAGE) dirs.push_back(TIFFCurrentDirOffset(tif));
+            }
+        }
+        for (uint64_t d : dirs) {
+            Level l;
+            int t = -1;
+            const Level& up = lv.back();
+            if (lv.size() >= size_t(kMaxLevels) || !TIFFSetSubDirectory(tif, d) || !readLevel(tif, l, t)
+                || t != type || (l.w != up.w / 2 && l.w != (up.w + 1) / 2)
+                || (l.h != up.h / 2 && l.h != (up.h + 1) / 2))
+                break;
+            lv.push_back(l);
+        }
+        if (!TIFFSetSubDirectory(tif, lv[0].dir)) { TIFFClose(tif); return nullptr; }
+        return std::shared_ptr<TiledImage>(new TiffImage(tif, std::move(lv), type));
+    }
+    ~TiffImage() override { TIFFClose(tif); }
+
+    cv::Size size(int level) const override {
+        const Level& l = lv[std::clamp(level, 0, levels() - 1)];
+        return cv::Size(int(l.w), int(l.h));
+    }
+    int levels() const override { return int(lv.size()); }
+    int type() const override { return typ; }
+    ChannelOrder order() const override { return ChannelOrder::RGB; }
+
+    void read(const cv::Rect& rect, cv::Mat& out, int level) const override {
+        level = std::clamp(level, 0, levels() - 1);
+        const Level& l = lv[level];
+        cv::Rect r = rect & cv::Rect(0, 0, int(l.w), int(l.h));
+        out.create(r.size(), typ);
+        if (r.empty()) return;
+        std::lock_guard<std::mutex> lk(m);   // a TIFF handle isn't thread-safe
+        if (level != current) {
+            if (!TIFFSetSubDirectory(tif, l.dir)) throw std::runtime_error("Failed to read TIFF level");
+            current = level;
+        }
+        std::vector<uchar> buf(TIFFTileSize(tif));
+        int tW = int(l.tw), tH = int(l.th);
+        for (int ty = r.y / tH; ty * tH < r.y + r.height; ty++)
+            for (int tx = r.x / tW; tx * tW < r.x + r.width; tx++) {
+                if (TIFFReadTile(tif, buf.data(), uint32_t(tx*tW), uint32_t(ty*tH), 0, 0) < 0)
+                    throw std::runtime_error("Failed to read TIFF tile");
+                copyFromTile(buf.data(), size_t(tW) * CV_ELEM_SIZE(typ), cv::Rect(tx*tW, ty*tH, tW, tH), r, out);
+            }
+    }
+
+private:
+    struct Level {
+        uint64_t dir = 0;
+        uint32_t w = 0, h = 0, tw = 0, th = 0;
+    };
+    // The current directory as a level; false unless tiled, chunky, 8 or
+    // 16 bits and 1, 3 or 4 channels.
+    static bool readLevel(TIFF* tif, Level& l, int& type) {
+        uint16_t bits = 0, spp = 0, planar = PLANARCONFIG_CONTIG;
+        TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &l.w);
+        TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &l.h);
+        TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &bits);
+        TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &spp);
+        TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planar);
+        bool usable = TIFFIsTiled(tif) && TIFFGetField(tif, TIFFTAG_TILEWIDTH, &l.tw)
+                   && TIFFGetField(tif, TIFFTAG_TILELENGTH, &l.th)
+                   && l.w > 0 && l.h > 0 && l.tw > 0 && l.th > 0
+                   && (bits == 8 || bits == 16) && (spp == 1 || spp == 3 || spp == 4)
+                   && planar == PLANARCONFIG_CONTIG;
+        if (!usable) return false;
+        l.dir = TIFFCurrentDirOffset(tif);
+        type = CV_MAKETYPE(bits == 8 ? CV_8U : CV_16U, spp);
+        return true;
+    }
+    TiffImage(TIFF* t, std::vector<Level> levels, int type) : tif(t), lv(std::move(levels)), typ(type) {}
+    TIFF* tif;
+    std::vector<Level> lv;
+    int typ;
+    mutable int current = 0;
+    mutable std::mutex m;
+};
+#endif
+
+}
+
+std::shared_ptr<TiledImage> openTiledImage(const std::string& path) {
+    std::string ext = lowerExtension(path);
+    if (ext == ".ntf") return std::make_shared<MappedImage>(path);
+#ifdef NODE_HAVE_TIFF
+    if (ext == ".tif" || ext == ".tiff") return TiffImage::open(path);
+#endif
+    return nullptr;
+}
+
+void writeTiledImage(const std::string& path, const cv::Mat& img, ChannelOrder order, int tileSize,
+                     const std::function<void(double)>& progress) {
+    if (img.empty()) throw std::runtime_error("Nothing to write to " + path);
+    int ts = std::max(16, tileSize);
+    NtfHeader h{};
+    std::memcpy(h.magic, "NTF1", 4);
+    h.version = 1;
+    h.width = uint32_t(img.cols);
+    h.height = uint32_t(img.rows);
+    h.type = uint32_t(img.type());
+    h.order = uint32_t(order);
+    h.tileSize = uint32_t(ts);
+    h.levels = 1;
+    for (cv::Size s = img.size(); std::max(s.width, s.height) > ts && h.levels < kMaxLevels; h.levels++)
+        s = levelSize(s, 1);
+
+    std::ofstream f(path, std::ios::binary);
+    if (!f) throw std::runtime_error("Cannot write " + path);
+    f.write(reinterpret_cast<const char*>(&h), sizeof h);
+
+    size_t rowsTotal = 0, rowsDone = 0;
+    for (int k = 0; k < int(h.levels); k++) rowsTotal += size_t(levelSize(img.size(), k).height + ts - 1) / ts;
+    size_t es = img.elemSize(), tileBytes = size_t(ts) * ts * es;
+    std::vector<uchar> strip;
+    cv::Mat level = img;
+    for (int k = 0; k < int(h.levels); k++) {
+        if (k > 0) cv::pyrDown(level, level);
+        h.levelOffset[k] = uint64_t(f.tellp());
+        int across = (level.cols + ts - 1) / ts;
+        // A row of tiles is contiguous on disk: pack it in parallel, write it once.
+        strip.assign(tileBytes * across, 0);
+        for (int y = 0; y < level.rows; y += ts) {
+            int rows = std::min(ts, level.rows - y);
+            cv::parallel_for_(cv::Range(0, across), [&](const cv::Range& range){
+                for (int tx = range.start; tx < range.end; tx++) {
+                    uchar* tile = &strip[tileBytes * tx];
+                    int x = tx * ts, cols = std::min(ts, level.cols - x);
+                    for (int row = 0; row < rows; row++) {
+                        uchar* dst = tile + size_t(row) * ts * es;
+                        std::memcpy(dst, level.ptr(y + row) + size_t(x) * es, size_t(cols) * es);
+                        std::memset(dst + size_t(cols) * es, 0, size_t(ts - cols) * es);
+                    }
+                    std::memset(tile + size_t(rows) * ts * es, 0, size_t(ts - rows) * ts * es);
+                }
+            });
+            f.write(reinterpret_cast<const char*>(strip.data()), std::streamsize(strip.size()));
+            if (progress) progress(double(++rowsDone) / rowsTotal);
+        }
+    }
+    f.seekp(0);
+    f.write(reinterpret_cast<const char*>(&h), sizeof h);
+    if (!f) throw std::runtime_error("Failed writing " + path);
+}
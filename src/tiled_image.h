@@ -0,0 +1,33 @@
+// ----------------- tiled_image.h -----------------
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include "frame.h"
+
+// Image on disk that is read a region at a time, so only the tiles a region
+// touches are ever loaded. Level k is a 2^k reduction; level 0 is full size.
+class TiledImage {
+public:
+    virtual ~TiledImage() = default;
+    virtual cv::Size size(int level = 0) const = 0;
+    virtual int levels() const = 0;
+    virtual int type() const = 0;
+    virtual ChannelOrder order() const = 0;
+    // Copies `rect` (clipped to the level) into `out`. Safe to call from
+    // several threads at once.
+    virtual void read(const cv::Rect& rect, cv::Mat& out, int level = 0) const = 0;
+};
+
+// Opens a .ntf file by memory-mapping it, or a tiled TIFF when built with
+// libtiff. Returns nullptr for other files; throws if a .ntf is damaged.
+std::shared_ptr<TiledImage> openTiledImage(const std::string& path);
+
+// .ntf ("node tiled format"): a small header, then each pyramid level as a
+// grid of fixed-size raw tiles stored row-major. Edge tiles are padded so
+// every tile has the same size and offset arithmetic. Pixels are stored as
+// given, in `order`; no colour conversion happens on either side. Each row
+// of tiles is packed in parallel; `progress` gets the fraction written.
+void writeTiledImage(const std::string& path, const cv::Mat& img, ChannelOrder order,
+                     int tileSize = 256, const std::function<void(double)>& progress = {});
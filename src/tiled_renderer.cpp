@@ -0,0 +1,113 @@
+#include "tiled_renderer.h"
+#include "node_framework.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+
+TiledRenderer::TiledRenderer(ThreadPool& pool, TileOptions options)
+  : pool(pool), options(options) {}
+
+cv::Mat TiledRenderer::pull(const Node* node, const cv::Rect& rect) const {
+    cv::Mat in;
+    cv::Rect inRect;
+    if (!node->inputs.empty() && !node->inputs[0].connections.empty()) {
+        const Node* up = node->inputs[0].connections[0].node;
+        inRect = node->inputFootprint(rect) & cv::Rect(cv::Point(0,0), up->outputSize());
+        in = pull(up, inRect);
+    }
+    cv::Mat out;
+    if (!node->processTile(in, inRect, rect, out))
+        throw std::runtime_error(node->name + " does not support tiled evaluation");
+    return out;
+}
+
+// Rough peak bytes for one tile: every node's footprint along the chain,
+// assuming 8-bit channels and one temporary per node.
+size_t TiledRenderer::tileCost(const Node* output, const cv::Rect& tile) const {
+    size_t bytes = 0;
+    cv::Rect r = tile;
+    for (const Node* n = output; n; ) {
+        bytes += size_t(r.area()) * 4 * 2;
+        if (n->inputs.empty() || n->inputs[0].connections.empty()) break;
+        r = n->inputFootprint(r);
+        n = n->inputs[0].connections[0].node;
+    }
+    return bytes;
+}
+
+void TiledRenderer::render(const Node* output, cv::Rect region, const TileSink& sink) {
+    cv::Rect domain(cv::Point(0,0), output->outputSize());
+    region = region.empty() ? domain : region & domain;
+    if (region.empty()) return;
+
+    std::vector<cv::Rect> tiles;
+    int ts = std::max(16, options.tileSize);
+    for (int y = region.y; y < region.y + region.height; y += ts)
+        for (int x = region.x; x < region.x + region.width; x += ts)
+            tiles.push_back(cv::Rect(x, y, ts, ts) & region);
+
+    // Only as many tiles in flight as the memory budget allows.
+    size_t cost = std::max<size_t>(1, tileCost(output, tiles[0]));
+    size_t lanes = std::clamp<size_t>(options.memoryBudget / cost, 1, pool.size());
+    lanes = std::min(lanes, tiles.size());
+
+    struct State {
+        std::atomic<size_t> next{0};
+        std::mutex m;
+        std::condition_variable done;
+        size_t running = 0;
+        std::exception_ptr failure;
+    };
+    auto st = std::make_shared<State>();
+    st->running = lanes;
+    for (size_t l = 0; l < lanes; l++) {
+        pool.submit([this, st, &tiles, output, &sink]{
+            for (size_t i; (i = st->next++) < tiles.size(); ) {
+                try {
+                    sink(tiles[i], pull(output, tiles[i]));
+                } catch (...) {
+                    std::lock_guard<std::mutex> lk(st->m);
+                    if (!st->failure) st->failure = std::current_exception();
+                    st->next = tiles.size();
+                }
+            }
+            std::lock_guard<std::mutex> lk(st->m);
+            if (--st->running == 0) st->done.notify_all();
+        });
+    }
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(st->m);
+            if (st->running == 0) break;
+        }
+        if (pool.tryRunOne()) continue;
+        std::unique_lock<std::mutex> lk(st->m);
+        st->done.wait_for(lk, std::chrono::milliseconds(1), [&]{ return st->running == 0; });
+    }
+    if (st->failure) std::rethrow_exception(st->failure);
+}
+
+cv::Mat TiledRenderer::render(const Node* output, cv::Rect region,
+                              const std::function<void(double)>& progress) {
+    cv::Rect domain(cv::Point(0,0), output->outputSize());
+    region = region.empty() ? domain : region & domain;
+    int ts = std::max(16, options.tileSize);
+    double total = double((region.width + ts - 1) / ts) * ((region.height + ts - 1) / ts);
+    std::atomic<int> done{0};
+    cv::Mat result;
+    std::mutex m;
+    render(output, region, [&](const cv::Rect& r, const cv::Mat& tile){
+        {
+            // Allocated on the first tile, once the output type is known.
+            std::lock_guard<std::mutex> lk(m);
+            if (result.empty()) result.create(region.size(), tile.type());
+        }
+        cv::Mat dst = result(r - region.tl());
+        tile.copyTo(dst);
+        if (progress) progress(++done / total);
+    });
+    return result;
+}
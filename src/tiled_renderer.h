@@ -0,0 +1,38 @@
+// ----------------- tiled_renderer.h -----------------
+#pragma once
+#include <functional>
+#include <opencv2/opencv.hpp>
+
+class Node;
+class ThreadPool;
+
+struct TileOptions {
+    int tileSize = 512;
+    size_t memoryBudget = size_t(512) << 20; // bytes of tiles in flight
+};
+
+// Evaluates a graph one output tile at a time instead of whole frames, so
+// peak memory depends on tile size and parallelism rather than image size
+// times node count. Each tile pulls only the input footprint its nodes ask
+// for, recursively up to the source.
+class TiledRenderer {
+public:
+    using TileSink = std::function<void(const cv::Rect&, const cv::Mat&)>;
+
+    explicit TiledRenderer(ThreadPool& pool, TileOptions options = {});
+
+    // Renders `region` of `output` (the whole image if empty). `sink` gets
+    // every finished tile and may be called from several threads at once.
+    void render(const Node* output, cv::Rect region, const TileSink& sink);
+    // Convenience: assembles the tiles of `region` into one image.
+    // `progress` gets the fraction of tiles done, from any thread.
+    cv::Mat render(const Node* output, cv::Rect region = cv::Rect(),
+                   const std::function<void(double)>& progress = {});
+
+private:
+    cv::Mat pull(const Node* node, const cv::Rect& rect) const;
+    size_t tileCost(const Node* output, const cv::Rect& tile) const;
+
+    ThreadPool& pool;
+    TileOptions options;
+};